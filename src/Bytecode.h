@@ -0,0 +1,101 @@
+/**
+ * @file Bytecode.h
+ * @brief Instruction set and program container for compiled expressions
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#ifndef BYTECODE_H
+#define BYTECODE_H
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Value.h"
+
+/**
+ * @def OPCODE_LIST
+ * @brief All VM operations, expanded into the OpCode enum and into the VM dispatch tables
+ *
+ * The VM is a simple stack machine, every instruction pops its operands from
+ * the value stack and pushes its result back. Halt has to stay last.
+ */
+#define OPCODE_LIST(X) \
+    X(PushInt)       /* push arg as int */ \
+    X(PushBool)      /* push arg as bool */ \
+    X(PushString)    /* push strings[arg] */ \
+    X(PushConst)     /* push constants[arg] */ \
+    X(LoadVar)       /* push value of variable in slot arg */ \
+    X(StoreVar)      /* pop value and assign it to variable in slot arg */ \
+    X(Defined)       /* push true if strings[arg] is the current input */ \
+    X(ValueOf)       /* push value of input strings[arg] */ \
+    X(Atoi)          /* pop string, push int */ \
+    X(Elapsed)       /* push milliseconds spent in the current state */ \
+    X(Output)        /* pop value and write it to output in slot arg */ \
+    X(Add) \
+    X(Sub) \
+    X(Mul) \
+    X(Div) \
+    X(Mod) \
+    X(Neg) \
+    X(Not) \
+    X(Eq) \
+    X(Ne) \
+    X(Lt) \
+    X(Le) \
+    X(Gt) \
+    X(Ge) \
+    X(InputEqInt)    /* push atoi(valueof(strings[arg])) == arg2 */ \
+    X(InputNeInt)    /* push atoi(valueof(strings[arg])) != arg2 */ \
+    X(InputLtInt)    /* push atoi(valueof(strings[arg])) < arg2 */ \
+    X(InputLeInt)    /* push atoi(valueof(strings[arg])) <= arg2 */ \
+    X(InputGtInt)    /* push atoi(valueof(strings[arg])) > arg2 */ \
+    X(InputGeInt)    /* push atoi(valueof(strings[arg])) >= arg2 */ \
+    X(ToBool)        /* pop value, push its truthiness */ \
+    X(Jump)          /* jump to instruction arg */ \
+    X(JumpIfFalse)   /* pop value, jump to instruction arg if it is false */ \
+    X(Pop) \
+    X(Halt)
+
+/**
+ * @enum OpCode
+ * @brief Operations understood by the expression VM (CodeExecutor), see OPCODE_LIST
+ */
+enum class OpCode : uint8_t {
+#define OPCODE_ENUM(name) name,
+    OPCODE_LIST(OPCODE_ENUM)
+#undef OPCODE_ENUM
+};
+
+/**
+ * @struct Instruction
+ * @brief One VM instruction, meaning of arg and arg2 depends on the opcode
+ */
+struct Instruction {
+    OpCode op;
+    int arg;
+    int arg2 = 0; // Second operand of fused instructions
+};
+
+/**
+ * @struct Program
+ * @brief Compiled form of a guard or a state action
+ */
+struct Program {
+    std::vector<Instruction> code; // Instructions, always terminated by Halt
+    std::vector<std::string> strings; // String constants referenced by instructions
+    std::vector<Value> constants; // Folded values of any type
+    bool valid = false; // False if source was empty or failed to compile
+    bool readsVariables = false; // Result depends on values of machine variables
+    bool readsTime = false; // Result depends on elapsed(), so it can not be cached
+
+    /**
+     * @brief Checks if there is anything to execute
+     * @return true if program is valid and does more than halt
+     */
+    bool empty() const {
+        return !valid || code.size() <= 1;
+    }
+};
+
+#endif // BYTECODE_H
@@ -0,0 +1,111 @@
+/**
+ * @file Clock.cpp
+ * @brief Implementation of the real and virtual clocks
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#include <algorithm>
+#include <thread>
+#include "Clock.h"
+
+using namespace std;
+
+shared_ptr<Clock> Clock::real() {
+    static shared_ptr<Clock> clock = make_shared<RealClock>();
+    return clock;
+}
+
+void RealClock::sleepFor(chrono::milliseconds duration) {
+    this_thread::sleep_for(duration);
+}
+
+bool RealClock::waitUntil(unique_lock<mutex>& lock, condition_variable& cv, TimePoint deadline, const function<bool()>& condition) {
+    return cv.wait_until(lock, deadline, condition);
+}
+
+void VirtualClock::sleepFor(chrono::milliseconds duration) {
+    advanceBy(duration);
+}
+
+bool VirtualClock::waitUntil(unique_lock<mutex>& lock, condition_variable& cv, TimePoint deadline, const function<bool()>& condition) {
+    Waiter waiter{deadline, lock.mutex(), &cv};
+    {
+        lock_guard<mutex> guard(waitersMutex);
+        waiters.push_back(&waiter);
+    }
+
+    // Only advanceTo() or the owner of the condition wake the thread, real time plays no role
+    while (!condition() && now() < deadline) {
+        cv.wait(lock);
+    }
+
+    {
+        lock_guard<mutex> guard(waitersMutex);
+        waiters.erase(find(waiters.begin(), waiters.end(), &waiter));
+    }
+    return condition();
+}
+
+void VirtualClock::notifyAt(TimePoint due) {
+    lock_guard<mutex> guard(waitersMutex);
+    if (due > now()) {
+        dueTimes.insert(due);
+    }
+}
+
+void VirtualClock::cancelNotify(TimePoint due) {
+    // advance() must not jump to a time nothing is due at anymore
+    lock_guard<mutex> guard(waitersMutex);
+    auto it = dueTimes.find(due);
+    if (it != dueTimes.end()) {
+        dueTimes.erase(it);
+    }
+}
+
+void VirtualClock::advanceTo(TimePoint time) {
+    vector<Waiter> woken;
+    {
+        lock_guard<mutex> guard(waitersMutex);
+        if (time <= now()) {
+            return;
+        }
+        ticks.store(time.time_since_epoch().count(), memory_order_release);
+        dueTimes.erase(dueTimes.begin(), dueTimes.upper_bound(time));
+        for (Waiter* waiter : waiters) {
+            if (waiter->deadline <= time) {
+                woken.push_back(*waiter);
+            }
+        }
+    }
+
+    // Lock of the waiter makes sure it is either before its check or already waiting
+    for (const Waiter& waiter : woken) {
+        lock_guard<mutex> guard(*waiter.mutex);
+        waiter.cv->notify_all();
+    }
+}
+
+bool VirtualClock::advance() {
+    TimePoint next = TimePoint::max();
+    {
+        lock_guard<mutex> guard(waitersMutex);
+
+        // Announced timers win, their threads may wait for earlier intermediate deadlines
+        if (!dueTimes.empty()) {
+            next = *dueTimes.begin();
+        }
+        else {
+            for (Waiter* waiter : waiters) {
+                // Waiter woken before may not have left yet
+                if (waiter->deadline > now()) {
+                    next = min(next, waiter->deadline);
+                }
+            }
+        }
+    }
+    if (next == TimePoint::max()) {
+        return false;
+    }
+    advanceTo(next);
+    return true;
+}
@@ -0,0 +1,161 @@
+/**
+ * @file Clock.h
+ * @brief Time source of the simulation, real time or virtual time for replay and tests
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#ifndef CLOCK_H
+#define CLOCK_H
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+/**
+ * @class Clock
+ * @brief Source of time for delays and elapsed()
+ *
+ * Everything that waits or measures time in the simulation goes through a Clock,
+ * so a run can be switched from real time to VirtualClock without other changes.
+ */
+class Clock {
+public:
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    virtual ~Clock() = default;
+
+    /**
+     * @brief Gets current time
+     */
+    virtual TimePoint now() const = 0;
+
+    /**
+     * @brief Blocks the calling thread for the duration
+     * @param duration Time to wait
+     */
+    virtual void sleepFor(std::chrono::milliseconds duration) = 0;
+
+    /**
+     * @brief Waits on the condition variable until the deadline or until the condition holds
+     *
+     * Same contract as std::condition_variable::wait_until with a predicate.
+     * The mutex and the condition variable have to outlive the clock.
+     *
+     * @param lock Locked lock of the mutex guarding the condition
+     * @param cv Condition variable notified when the condition changes
+     * @param deadline Time to give up
+     * @param condition Predicate checked with the lock held
+     * @return Value of the condition when the wait ends, false means the deadline passed
+     */
+    virtual bool waitUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& cv, TimePoint deadline, const std::function<bool()>& condition) = 0;
+
+    /**
+     * @brief Tells the clock something is due at the time, used by timers that do not block a thread
+     * @param due Time something is due
+     */
+    virtual void notifyAt(TimePoint due) {
+        (void)due;
+    }
+
+    /**
+     * @brief Takes back one time passed to notifyAt(), the timer was cancelled
+     * @param due Time passed to notifyAt()
+     */
+    virtual void cancelNotify(TimePoint due) {
+        (void)due;
+    }
+
+    /**
+     * @brief Gets shared real time clock
+     */
+    static std::shared_ptr<Clock> real();
+};
+
+/**
+ * @class RealClock
+ * @brief Clock following std::chrono::steady_clock
+ */
+class RealClock : public Clock {
+public:
+    TimePoint now() const override {
+        return std::chrono::steady_clock::now();
+    }
+
+    void sleepFor(std::chrono::milliseconds duration) override;
+
+    bool waitUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& cv, TimePoint deadline, const std::function<bool()>& condition) override;
+};
+
+/**
+ * @class VirtualClock
+ * @brief Clock that moves only when told to, waits never take real time
+ *
+ * sleepFor() moves the time forward at once, advance() jumps straight to the
+ * earliest deadline somebody waits for. Time starts at zero, so runs with the same
+ * inputs give the same timing every time.
+ */
+class VirtualClock : public Clock {
+private:
+    /**
+     * @struct Waiter
+     * @brief Thread blocked in waitUntil()
+     */
+    struct Waiter {
+        TimePoint deadline;
+        std::mutex* mutex;
+        std::condition_variable* cv;
+    };
+
+    // Current time as ticks of steady_clock, read without the lock
+    std::atomic<TimePoint::rep> ticks{0};
+
+    // Protects waiters and dueTimes
+    mutable std::mutex waitersMutex;
+
+    // Threads blocked in waitUntil()
+    std::vector<Waiter*> waiters;
+
+    // Times passed to notifyAt() that did not come yet and were not cancelled
+    std::multiset<TimePoint> dueTimes;
+
+public:
+    TimePoint now() const override {
+        return TimePoint(TimePoint::duration(ticks.load(std::memory_order_acquire)));
+    }
+
+    void sleepFor(std::chrono::milliseconds duration) override;
+
+    bool waitUntil(std::unique_lock<std::mutex>& lock, std::condition_variable& cv, TimePoint deadline, const std::function<bool()>& condition) override;
+
+    void notifyAt(TimePoint due) override;
+
+    void cancelNotify(TimePoint due) override;
+
+    /**
+     * @brief Moves time forward and wakes waiters whose deadline passed
+     * @param time New time, ignored if it is not later than now()
+     */
+    void advanceTo(TimePoint time);
+
+    /**
+     * @brief Moves time forward by the duration
+     * @param duration Time to add
+     */
+    void advanceBy(std::chrono::milliseconds duration) {
+        advanceTo(now() + duration);
+    }
+
+    /**
+     * @brief Jumps to the earliest time passed to notifyAt(), or to the earliest waiter deadline if there is none
+     * @return false if nothing waits
+     */
+    bool advance();
+};
+
+#endif // CLOCK_H
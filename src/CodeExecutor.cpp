@@ -4,6 +4,7 @@
  * @author Tomáš Šedo (xsedot00)
 */
 
+#include <cstdlib>
 #include <iostream>
 #include <unordered_map>
 #include <string>
@@ -12,10 +13,21 @@
 
 using namespace std;
 
-CodeExecutor::CodeExecutor(MooreMachine& mooreMachine, const string& stateExpr, const string& transitionExpr, const string& inputName, const string& inputValue)
-    : mooreMachine(mooreMachine), stateExpr(stateExpr), transitionExpr(transitionExpr), inputName(inputName), inputValue(inputValue) {};
+// Grows to the deepest expression once, afterwards evaluation does not allocate
+static vector<Value>& threadStack() {
+    thread_local vector<Value> stack;
+    return stack;
+}
+
+CodeExecutor::CodeExecutor(const InstanceView& instance, string_view inputName, string_view inputValue)
+    : instance(instance), inputName(inputName), inputValue(inputValue), stack(threadStack()) {
+};
+
+CodeExecutor::CodeExecutor(MachineInstance& instance, string_view inputName, string_view inputValue)
+    : CodeExecutor(instance.view(), inputName, inputValue) {
+};
 
-bool CodeExecutor::defined(const string& inputName) {
+bool CodeExecutor::defined(string_view inputName) {
     if (this->inputName == inputName) {
         return true;
     }
@@ -23,168 +35,264 @@ bool CodeExecutor::defined(const string& inputName) {
     return false;
 }
 
-string CodeExecutor::valueof(const string& inputName) {
-    for (const auto& input : mooreMachine.getInputs()) {
-        if (input == inputName) {
-            return inputValue;
-        }
+string_view CodeExecutor::valueof(string_view inputName) {
+    if (this->inputName == inputName) {
+        return inputValue;
     }
     return "";
 }
 
-void CodeExecutor::output(const string& outputName, const string& value) {
-    mooreMachine.setCurrentOutput(outputName, value);
-}
-
-int CodeExecutor::atoi(const string& value) {
-    return stoi(value);
-}
-
-bool CodeExecutor::executeTransitionBoolExpr() {
-    bool condResult = evaluateCond(mooreMachine.removeSpaces(transitionExpr));
-    return condResult;
+void CodeExecutor::output(int slot, const Value& value) {
+    // Assign into the existing string so its buffer is reused
+    if (value.getType() == ValueType::String) {
+        instance.output(slot).assign(value.asString());
+    }
+    else {
+        instance.output(slot).assign(value.toString());
+    }
 }
 
-void CodeExecutor::executeStateExpr(const string& expr) {
-    // Remove all the whitespaces from the expression, easier to parse
-    string trimmedExpr = mooreMachine.removeSpaces(expr);
-    // Look for if statement
-    size_t ifPos = trimmedExpr.find("if{");
-    // Continue till there is no more if statements left
-    while (ifPos != string::npos) {
-        // if format: if {condition} {body}
-        // First we search condition and evaluate given condition
-        size_t condStart = trimmedExpr.find('{', ifPos) + 1;
-        size_t condEnd = trimmedExpr.find('}', condStart);
-        string condition = trimmedExpr.substr(condStart, condEnd - condStart);
-
-        // Then we look for body and evaluate it
-        size_t bodyStart = trimmedExpr.find('{', condEnd) + 1;
-        size_t bodyEnd = trimmedExpr.find('}', bodyStart);
-        string body = trimmedExpr.substr(bodyStart, bodyEnd - bodyStart);
-        cout << body << endl;
-
-        // We remove whole if statement and continue with rest of the expression
-        trimmedExpr = trimmedExpr.substr(bodyEnd + 1);
-        ifPos = trimmedExpr.find("if{");
+bool CodeExecutor::executeTransitionBoolExpr(const Program& guard) {
+    // Transition without guard can always be taken
+    if (guard.empty()) {
+        return true;
     }
 
-    // Look for built-in functions in the expr
-    string builtinFuncExpr;
-    size_t builtinFuncPos;
-    for (const auto& builtinFunc : builtinFuncs) {
-        size_t pos = trimmedExpr.find(builtinFunc);
-        if (pos != string::npos) {
-            builtinFuncExpr = trimmedExpr.substr(pos, trimmedExpr.find(')', pos) + 1 - pos);;
-            builtinFuncPos = pos;
-        }
+    Value result = run(guard);
+    if (result.getType() != ValueType::Bool) {
+        cout << "Transition expression condition doesn't return bool value" << endl;
+        return false;
     }
-
-    ExprValue builtinFuncEval = evaluateExpr(builtinFuncExpr);
-
+    return result.asBool();
 }
 
-bool CodeExecutor::evaluateCond(const string& cond) {
-    string operatorFound;
-    size_t operatorPos;
-
-    // Look for the operator
-    for (const auto& op : operators) {
-        size_t pos = cond.find(op);
-        if (pos != string::npos) {
-            operatorFound = op;
-            operatorPos = pos;
-            break;
-        }
+void CodeExecutor::executeStateExpr(const Program& action) {
+    if (action.empty()) {
+        return;
     }
+    run(action);
+}
 
-    // If operator was not found then it means it can be built-in func that return bool value like defined
-    if (operatorFound.empty()) {
-        ExprValue exprEval = evaluateExpr(cond);
-        if (holds_alternative<bool>(exprEval)) {
-            return get<bool>(exprEval);
-        }
-
-        else {
-            cout << "Transition expression condition doesn't return bool value" << endl;
-        }
+int CodeExecutor::inputAsInt(string_view inputName) {
+    if (this->inputName != inputName) {
+        return 0;
     }
 
-    // Extract expression from both sides
-    string left = cond.substr(0, operatorPos);
-    string right = cond.substr(operatorPos + operatorFound.length());
-
-    // Evaluate both expressions
-    ExprValue leftEval = evaluateExpr(left);
-    ExprValue rightEval = evaluateExpr(right);
-
-    // Compare those expressions
-    bool condResult = compareExprValues(leftEval, rightEval, operatorFound);
-    return condResult;
+    // Input value does not change during the event, parse it only once
+    if (!inputIntParsed) {
+        inputInt = Value::parseInt(inputValue);
+        inputIntParsed = true;
+    }
+    return inputInt;
 }
 
-ExprValue CodeExecutor::evaluateExpr(const string& expr) {
-    if ( expr == "") {
-        return -1;
+// Computed goto is a GCC/Clang extension, other compilers dispatch through a switch
+#if defined(__GNUC__) || defined(__clang__)
+#define CODE_EXECUTOR_THREADED
+#endif
+
+#ifdef CODE_EXECUTOR_THREADED
+#define DISPATCH() goto *dispatchTable[static_cast<size_t>(pc->op)]
+#else
+#define DISPATCH() goto dispatch
+#endif
+
+Value CodeExecutor::run(const Program& program) {
+    stack.clear();
+    const Instruction* code = program.code.data();
+    const Instruction* pc = code;
+
+#ifdef CODE_EXECUTOR_THREADED
+    // Label of every opcode handler, in OpCode order
+    static const void* const dispatchTable[] = {
+#define OPCODE_LABEL(name) &&op_##name,
+        OPCODE_LIST(OPCODE_LABEL)
+#undef OPCODE_LABEL
+    };
+    DISPATCH();
+#else
+dispatch:
+    switch (pc->op) {
+#define OPCODE_CASE(name) case OpCode::name: goto op_##name;
+        OPCODE_LIST(OPCODE_CASE)
+#undef OPCODE_CASE
     }
-
-    // defined func
-    size_t definedPos = expr.find("defined(");
-    if (definedPos != string::npos) {
-        size_t varStart = expr.find('"', definedPos) + 1;
-        size_t varEnd = expr.find('"', varStart);
-        string varName = expr.substr(varStart, varEnd - varStart);
-
-        return defined(varName);
+#endif
+
+op_PushInt:
+    stack.emplace_back(pc->arg);
+    pc++;
+    DISPATCH();
+
+op_PushBool:
+    stack.emplace_back(pc->arg != 0);
+    pc++;
+    DISPATCH();
+
+op_PushString:
+    stack.push_back(Value::view(program.strings[pc->arg]));
+    pc++;
+    DISPATCH();
+
+op_PushConst:
+    stack.push_back(program.constants[pc->arg].ref());
+    pc++;
+    DISPATCH();
+
+op_LoadVar:
+    stack.push_back(instance.variable(pc->arg).ref());
+    pc++;
+    DISPATCH();
+
+op_StoreVar:
+    {
+        // Variable keeps its declared type and owns its text
+        Value& var = instance.variable(pc->arg);
+        Value value = stack.back().convert(var.getType());
+        value.own();
+        var = move(value);
+        stack.pop_back();
+        instance.variablesChanged();
     }
-
-    // atoi func
-    // We check if the string inside is a number and only then make it an integer
-    // Recursively checks if variable or input was given
-    size_t atoiPos = expr.find("atoi(");
-    if (atoiPos != string::npos) {
-        size_t insideExprStart = expr.find('(', atoiPos) + 1;
-        size_t insideExprEnd = expr.find(')', insideExprStart);
-        string insideExpr = expr.substr(insideExprStart, insideExprEnd - insideExprStart);
-
-        if (holds_alternative<string>(evaluateExpr(insideExpr)) && isNumber(get<string>(evaluateExpr(insideExpr)))) {
-            return atoi(get<string>(evaluateExpr(insideExpr)));
-        };
+    pc++;
+    DISPATCH();
+
+op_Defined:
+    stack.emplace_back(defined(program.strings[pc->arg]));
+    pc++;
+    DISPATCH();
+
+op_ValueOf:
+    stack.push_back(Value::view(valueof(program.strings[pc->arg])));
+    pc++;
+    DISPATCH();
+
+op_Atoi:
+    stack.back() = stack.back().asInt();
+    pc++;
+    DISPATCH();
+
+op_Elapsed:
+    stack.emplace_back(instance.getElapsed());
+    pc++;
+    DISPATCH();
+
+op_Output:
+    output(pc->arg, stack.back());
+    stack.pop_back();
+    pc++;
+    DISPATCH();
+
+op_Add:
+op_Sub:
+op_Mul:
+op_Div:
+op_Mod:
+    {
+        Value right = move(stack.back());
+        stack.pop_back();
+        stack.back() = arithmetic(stack.back(), right, pc->op);
     }
+    pc++;
+    DISPATCH();
 
-    // valueof func
-    size_t valueofPos = expr.find("valueof(");
-    if (valueofPos != string::npos) {
-        size_t varStart = expr.find('"', valueofPos) + 1;
-        size_t varEnd = expr.find('"', varStart);
-        string varName = expr.substr(varStart, varEnd - varStart);
-
-        return valueof(varName);
+op_Neg:
+    if (stack.back().getType() == ValueType::Double) {
+        stack.back() = -stack.back().asDouble();
     }
-
-    // output func
-    // Extracts output name and value to be assigned in it
-    size_t outputPos = expr.find("output(");
-    if (outputPos != string::npos) {
-        size_t outNameStart = expr.find('"', outputPos) + 1;
-        size_t outNameEnd = expr.find('"', outNameStart);
-        string outName = expr.substr(outNameStart, outNameEnd - outNameStart);
-        size_t outValueStart = expr.find(',', outputPos) + 1;
-        size_t outValueEnd = expr.find(')', outValueStart);
-        string outValue = expr.substr(outValueStart, outValueEnd - outValueStart);
-        output(outName, outValue);
-        return -1;
+    else {
+        stack.back() = -stack.back().asInt();
     }
-
-    // Expressions like string, integer
-    if (isNumber(expr)) {
-        return stoi(expr);
+    pc++;
+    DISPATCH();
+
+op_Not:
+    stack.back() = !stack.back().asBool();
+    pc++;
+    DISPATCH();
+
+op_Eq:
+op_Ne:
+op_Lt:
+op_Le:
+op_Gt:
+op_Ge:
+    {
+        Value right = move(stack.back());
+        stack.pop_back();
+        stack.back() = compareExprValues(stack.back(), right, pc->op);
+    }
+    pc++;
+    DISPATCH();
+
+op_InputEqInt:
+    stack.emplace_back(inputAsInt(program.strings[pc->arg]) == pc->arg2);
+    pc++;
+    DISPATCH();
+
+op_InputNeInt:
+    stack.emplace_back(inputAsInt(program.strings[pc->arg]) != pc->arg2);
+    pc++;
+    DISPATCH();
+
+op_InputLtInt:
+    stack.emplace_back(inputAsInt(program.strings[pc->arg]) < pc->arg2);
+    pc++;
+    DISPATCH();
+
+op_InputLeInt:
+    stack.emplace_back(inputAsInt(program.strings[pc->arg]) <= pc->arg2);
+    pc++;
+    DISPATCH();
+
+op_InputGtInt:
+    stack.emplace_back(inputAsInt(program.strings[pc->arg]) > pc->arg2);
+    pc++;
+    DISPATCH();
+
+op_InputGeInt:
+    stack.emplace_back(inputAsInt(program.strings[pc->arg]) >= pc->arg2);
+    pc++;
+    DISPATCH();
+
+op_ToBool:
+    stack.back() = stack.back().asBool();
+    pc++;
+    DISPATCH();
+
+op_Jump:
+    pc = code + pc->arg;
+    DISPATCH();
+
+op_JumpIfFalse:
+    if (stack.back().asBool()) {
+        pc++;
     }
+    else {
+        pc = code + pc->arg;
+    }
+    stack.pop_back();
+    DISPATCH();
+
+op_Pop:
+    stack.pop_back();
+    pc++;
+    DISPATCH();
 
-    return -1;
+op_Halt:
+    if (stack.empty()) {
+        return -1;
+    }
+    return stack.back();
 }
 
+#undef DISPATCH
+
 bool CodeExecutor::isNumber(const string& expr) {
+    if (expr.empty()) {
+        return false;
+    }
+
     for (char ch : expr) {
         if (!isdigit(ch)) {
             return false;
@@ -194,91 +302,154 @@ bool CodeExecutor::isNumber(const string& expr) {
     return true;
 }
 
-bool CodeExecutor::compareExprValues(const ExprValue& left, const ExprValue& right, const string& op) {
-    // Only compare if the types are the same
-    if (left.index() != right.index()) {
-        return false;
-    }
-
-    // Both are bool
-    if (holds_alternative<bool>(left) && holds_alternative<bool>(right)) {
-        bool leftValue = get<bool>(left);
-        bool rightValue = get<bool>(right);
-        if (op == "==") {
-            return leftValue == rightValue;
+Value CodeExecutor::arithmetic(const Value& left, const Value& right, OpCode op) {
+    // String concatenation
+    if (op == OpCode::Add && (left.getType() == ValueType::String || right.getType() == ValueType::String)) {
+        string result = left.toString();
+        if (right.getType() == ValueType::String) {
+            result += right.asString();
         }
-        if (op == "!=") {
-            return leftValue != rightValue;
+        else {
+            result += right.toString();
         }
+        return result;
     }
 
-    // Both are int
-    else if (holds_alternative<int>(left) && holds_alternative<int>(right)) {
-        int leftValue = get<int>(left);
-        int rightValue = get<int>(right);
-        if (op == "==") {
-            return leftValue == rightValue;
-        }
-        if (op == "!=") {
-            return leftValue != rightValue;
+    // Floating point arithmetic if any of the operands is double
+    if (left.getType() == ValueType::Double || right.getType() == ValueType::Double) {
+        double leftValue = left.asDouble();
+        double rightValue = right.asDouble();
+        switch (op) {
+            case OpCode::Add:
+                return leftValue + rightValue;
+            case OpCode::Sub:
+                return leftValue - rightValue;
+            case OpCode::Mul:
+                return leftValue * rightValue;
+            case OpCode::Div:
+                return leftValue / rightValue;
+            default:
+                break;
         }
-        if (op == "<") {
-            return leftValue < rightValue;
+    }
+
+    int leftValue = left.asInt();
+    int rightValue = right.asInt();
+    switch (op) {
+        case OpCode::Add:
+            return leftValue + rightValue;
+        case OpCode::Sub:
+            return leftValue - rightValue;
+        case OpCode::Mul:
+            return leftValue * rightValue;
+        case OpCode::Div:
+            if (rightValue == 0) {
+                cout << "Division by zero" << endl;
+                return 0;
+            }
+            return leftValue / rightValue;
+        case OpCode::Mod:
+            if (rightValue == 0) {
+                cout << "Division by zero" << endl;
+                return 0;
+            }
+            return leftValue % rightValue;
+        default:
+            return 0;
+    }
+}
+
+bool CodeExecutor::compareExprValues(const Value& left, const Value& right, OpCode op) {
+    // Numbers are compared by value, double wins over int and char
+    if (left.isNumeric() && right.isNumeric()) {
+        if (left.getType() == ValueType::Double || right.getType() == ValueType::Double) {
+            double leftValue = left.asDouble();
+            double rightValue = right.asDouble();
+            switch (op) {
+                case OpCode::Eq:
+                    return leftValue == rightValue;
+                case OpCode::Ne:
+                    return leftValue != rightValue;
+                case OpCode::Lt:
+                    return leftValue < rightValue;
+                case OpCode::Le:
+                    return leftValue <= rightValue;
+                case OpCode::Gt:
+                    return leftValue > rightValue;
+                case OpCode::Ge:
+                    return leftValue >= rightValue;
+                default:
+                    return false;
+            }
         }
-        if (op == "<=") {
-            return leftValue <= rightValue;
+
+        int leftValue = left.asInt();
+        int rightValue = right.asInt();
+        switch (op) {
+            case OpCode::Eq:
+                return leftValue == rightValue;
+            case OpCode::Ne:
+                return leftValue != rightValue;
+            case OpCode::Lt:
+                return leftValue < rightValue;
+            case OpCode::Le:
+                return leftValue <= rightValue;
+            case OpCode::Gt:
+                return leftValue > rightValue;
+            case OpCode::Ge:
+                return leftValue >= rightValue;
+            default:
+                return false;
         }
-        if (op == ">") {
-            return leftValue > rightValue;
+    }
+
+    // Otherwise only compare if the types are the same
+    if (left.getType() != right.getType()) {
+        return false;
+    }
+
+    // Both are bool
+    if (left.getType() == ValueType::Bool) {
+        if (op == OpCode::Eq) {
+            return left.asBool() == right.asBool();
         }
-        if (op == ">=") {
-            return leftValue >= rightValue;
+        if (op == OpCode::Ne) {
+            return left.asBool() != right.asBool();
         }
     }
 
     // Both are string
-    else if (holds_alternative<string>(left) && holds_alternative<string>(right)) {
-        string leftValue = get<string>(left);
-        string rightValue = get<string>(right);
-        if (op == "==") {
-            return leftValue == rightValue;
+    else {
+        if (op == OpCode::Eq) {
+            return left.asString() == right.asString();
         }
-        if (op == "!=") {
-            return leftValue != rightValue;
+        if (op == OpCode::Ne) {
+            return left.asString() != right.asString();
         }
     }
 
     return false;
 }
 
-void CodeExecutor::setVariable(const string& type, const string& name, const string& value) {
-    const auto& allowedTypes = mooreMachine.getAllowedTypes();
-    if (find(allowedTypes.begin(), allowedTypes.end(), type) == allowedTypes.end())
+void CodeExecutor::setVariable(const string& name, const string& value) {
+    int slot = instance.definition ? instance.definition->variableSlots.find(name) : -1;
+    if (slot == -1)
     {
-        cout << "Invalid variable type: " << type << " for variable: " << name << endl;
+        cout << "Variable \"" << name << "\" does not exist in machine" << endl;
         return;
     }
 
-    for (auto& var : mooreMachine.getVariables())
-    {
-        if (var.name == name)
-        {
-            var.type = type;
-            var.value = value;
-            return;
-        }
-    }
-    mooreMachine.getVariables().push_back({type, name, value});
+    Value& var = instance.variable(slot);
+    var = Value::parse(instance.definition->variables[slot].type, value);
+    instance.variablesChanged();
 }
 
 string CodeExecutor::getVariable(const std::string &name)
 {
-    for (const auto& var : mooreMachine.getVariables())
+    int slot = instance.definition ? instance.definition->variableSlots.find(name) : -1;
+    if (slot == -1)
     {
-        if (var.name == name)
-        {
-            return var.value;
-        }
+        return "";
     }
-    return "";
+    return instance.variable(slot).toString();
 }
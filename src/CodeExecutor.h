@@ -9,153 +9,157 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
-#include <variant>
 #include "Structs.h"
-#include "MooreMachine.h"
-
-/**
- * @typedef ExprValue
- * @brief Type definition for values that can be returned from expression evaluation
- */
-using ExprValue = std::variant<bool, int, std::string>;
+#include "Value.h"
+#include "Bytecode.h"
+#include "InstanceView.h"
+#include "MachineInstance.h"
 
 /**
  * @class CodeExecutor
- * @brief Class for executing code in the Moore machine
+ * @brief Small stack VM executing compiled guards and state actions of the Moore machine
  */
 class CodeExecutor {
 private:
-    // Reference to out machine
-    MooreMachine& mooreMachine;
-
-    // State action expression that will evaluate when we land on the state
-    std::string stateExpr;
-
-    // Transition expression of the state based on the input that will be evaluated
-    std::string transitionExpr;
+    // Runtime data of the running instance
+    InstanceView instance;
 
-    // Input name to know which input was selected
-    std::string inputName;
+    // Input name to know which input was selected, refers to the caller's string
+    std::string_view inputName;
 
-    // Value of the input
-    std::string inputValue;
+    // Value of the input, refers to the caller's string
+    std::string_view inputValue;
 
-    // Allowed operators for bool conditions
-    std::vector<std::string> operators = {"==", "!=", "<=", ">=", "<", ">"};
+    // Value stack of the VM, shared by all executors of the thread so events do not allocate
+    std::vector<Value>& stack;
 
-    // Built-in functions in our small interpreter
-    std::vector<std::string> builtinFuncs = {"atoi", "output", "valueof", "defined", "elapsed"};
+    // Input value parsed as int, filled on first use by fused instructions
+    int inputInt = 0;
+    bool inputIntParsed = false;
 
     /**
      * @brief Checks if the input name is defined
-     * 
+     *
      * @param inputName The name of the input to check
      * @return true if the input is defined, false otherwise
      */
-    bool defined(const std::string& inputName);
+    bool defined(std::string_view inputName);
 
     /**
      * @brief Gets the value of the input
-     * 
+     *
      * @param inputName The name of the input
-     * @return The value of the input
+     * @return The value of the input, empty if it is not the current input
      */
-    std::string valueof(const std::string& inputName);
+    std::string_view valueof(std::string_view inputName);
 
     /**
-     * @brief Outputs the value to the specified output name
-     * 
-     * @param outputName The name of the output
-     * @param value The value to output
-     * @return void
+     * @brief Gets the value of the input converted to int, same as atoi(valueof(inputName))
+     *
+     * @param inputName The name of the input
+     * @return The value of the input as int, 0 if it is not the current input
      */
-    void output(const std::string& outputName, const std::string& value);
+    int inputAsInt(std::string_view inputName);
 
     /**
-     * @brief Converts a string to an integer
-     * 
-     * @param value The string to convert
-     * @return The converted integer
+     * @brief Outputs the value to the specified output slot
+     *
+     * @param slot Slot of the output, resolved by the compiler
+     * @param value The value to output, strings are written without an intermediate copy
+     * @return void
      */
-    int atoi(const std::string& value);
+    void output(int slot, const Value& value);
 
     /**
-     * @brief Compares two expression values based on the operator
-     * 
-     * @param left The left expression value
-     * @param right The right expression value
-     * @param op The operator to use for comparison
-     * @return true if the comparison is true, false otherwise
+     * @brief Executes compiled program, uses computed goto dispatch on GCC and Clang
+     *
+     * @param program Valid program to execute
+     * @return Value left on the top of the stack, -1 if there is none
      */
-    bool compareExprValues(const ExprValue& left, const ExprValue& right, const std::string& op);
+    Value run(const Program& program);
 
 public:
     /**
      * @brief Constructor for the CodeExecutor class
-     * 
-     * @param mooreMachine Reference to the MooreMachine object
-     * @param stateExpr The state action expression
-     * @param transitionExpr The transition expression
-     * @param inputName The name of the input
-     * @param inputValue The value of the input
+     *
+     * @param instance View of the running instance the expressions read and write
+     * @param inputName The name of the input, has to outlive the executor
+     * @param inputValue The value of the input, has to outlive the executor
      */
-    CodeExecutor(MooreMachine& mooreMachine, const std::string& stateExpr, const std::string& transitionExpr, const std::string& inputName, const std::string& inputValue);
-    
+    CodeExecutor(const InstanceView& instance, std::string_view inputName, std::string_view inputValue);
+
     /**
-     * @brief Executes the transition expression to determine if a transition should occur
-     * 
-     * @return true if the transition should be taken, false otherwise
+     * @brief Constructor for the CodeExecutor class
+     *
+     * @param instance Running machine the expressions read and write
+     * @param inputName The name of the input, has to outlive the executor
+     * @param inputValue The value of the input, has to outlive the executor
      */
-    bool executeTransitionBoolExpr();
+    CodeExecutor(MachineInstance& instance, std::string_view inputName, std::string_view inputValue);
 
     /**
-     * @brief Executes actions associated with entering a state
-     * 
-     * @param expr The expression to execute
+     * @brief Executes the transition guard to determine if a transition should occur
+     *
+     * @param guard Compiled guard of the transition
+     * @return true if the transition should be taken, false otherwise
      */
-    void executeStateExpr(const std::string& expr);
+    bool executeTransitionBoolExpr(const Program& guard);
 
     /**
-     * @brief Evaluates a boolean condition expression
-     * 
-     * @param cond The condition to evaluate
-     * @return The boolean result of the condition
+     * @brief Executes actions associated with entering a state
+     *
+     * @param action Compiled output expression of the state
      */
-    bool evaluateCond(const std::string& cond);
+    void executeStateExpr(const Program& action);
 
     /**
-     * @brief Sets a variable in the Moore machine
-     * 
-     * @param type The data type of the variable ("int", "bool", "string")
+     * @brief Sets a variable of the running machine, value is converted to the declared type
+     *
+     * Variables no action assigns are folded into the compiled definition, setting them
+     * here does not change compiled expressions.
+     *
      * @param name The name of the variable
      * @param value The value to assign to the variable
      */
-    void setVariable(const std::string &type, const std::string &name, const std::string &value);
+    void setVariable(const std::string &name, const std::string &value);
 
     /**
-     * @brief Retrieves the value of a variable from the Moore machine
-     * 
+     * @brief Retrieves the value of a variable from the running machine
+     *
      * @param name The name of the variable to retrieve
      * @return The string representation of the variable's value
      */
     std::string getVariable(const std::string &name);
 
-    /**
-     * @brief Evaluates an expression and returns its value
-     * 
-     * @param expr The expression to evaluate
-     * @return The value of the expression as an ExprValue (bool, int, or string)
-     */
-    ExprValue evaluateExpr(const std::string& expr);
-
     /**
      * @brief Checks if a string represents a numeric value
-     * 
+     *
      * @param expr The string to check
      * @return true if the string is a valid number, false otherwise
      */
     static bool isNumber(const std::string& expr);
+
+    /**
+     * @brief Compares two expression values based on the operator
+     *
+     * @param left The left expression value
+     * @param right The right expression value
+     * @param op The comparison opcode (Eq, Ne, Lt, Le, Gt, Ge)
+     * @return true if the comparison is true, false otherwise
+     */
+    static bool compareExprValues(const Value& left, const Value& right, OpCode op);
+
+    /**
+     * @brief Applies arithmetic operator on two values
+     *
+     * @param left The left expression value
+     * @param right The right expression value
+     * @param op The arithmetic opcode (Add, Sub, Mul, Div, Mod)
+     * @return Result of the operation, double if any operand is double, strings are concatenated by Add
+     */
+    static Value arithmetic(const Value& left, const Value& right, OpCode op);
 };
 
 #endif // CODEEXECUTOR_H
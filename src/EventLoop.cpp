@@ -0,0 +1,174 @@
+/**
+ * @file EventLoop.cpp
+ * @brief Implementation of the EventLoop class
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#include <iostream>
+#include <thread>
+#include "EventLoop.h"
+
+using namespace std;
+
+EventLoop::EventLoop(MooreMachine& machine, size_t capacity) : machine(machine), events(capacity) {
+    batch.resize(batchSize);
+}
+
+EventLoop::~EventLoop() {
+    stop();
+}
+
+void EventLoop::setResultCallback(ResultCallback callback) {
+    resultCallback = move(callback);
+}
+
+void EventLoop::start() {
+    if (running.exchange(true)) {
+        return;
+    }
+
+    // Delays are fired by the loop from now on
+    machine.setTimerThread(false);
+    definition = machine.getDefinition();
+
+    // Validity of every input is decided once, so resolving a name is one hash lookup
+    validInputs.assign(definition->inputSlots.size(), false);
+    validInputs[definition->inputSlots.find("")] = true;
+    for (const auto& input : definition->inputs) {
+        validInputs[definition->inputSlots.find(input)] = true;
+    }
+    publishedState.store(machine.getCurrentState(), memory_order_release);
+    worker = thread(&EventLoop::run, this);
+}
+
+void EventLoop::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(sleepMutex);
+    }
+    wakeUp.notify_all();
+    worker.join();
+}
+
+int EventLoop::findInput(const string& inputName) const {
+    int inputId = definition->inputSlots.find(inputName);
+    return inputId != -1 && validInputs[inputId] ? inputId : -1;
+}
+
+bool EventLoop::post(const string& inputName, const string& inputValue) {
+    int inputId = findInput(inputName);
+    if (inputId == -1) {
+        cout << "Input " << "\"" + inputName + "\" " << "is not valid" << endl;
+        return false;
+    }
+    post(inputId, inputValue);
+    return true;
+}
+
+void EventLoop::post(int inputId, const string& inputValue) {
+    push({inputId, inputValue});
+}
+
+void EventLoop::invoke(function<void()> task) {
+    tasks.push(move(task));
+    push({taskMarker, ""});
+}
+
+void EventLoop::push(const InputEvent& event) {
+    // Full queue slows the producer down to the speed of the loop
+    while (!events.push(event)) {
+        this_thread::yield();
+    }
+
+    // Pairs with the fence in run(), either the loop sees the event or this sees it sleeping
+    atomic_thread_fence(memory_order_seq_cst);
+    if (sleeping.load(memory_order_relaxed)) {
+        // Lock is taken only when the loop sleeps, it makes the wake up impossible to miss
+        lock_guard<mutex> lock(sleepMutex);
+        wakeUp.notify_one();
+    }
+}
+
+bool EventLoop::drain() {
+    bool processed = false;
+    while (size_t count = events.pop(batch.data(), batchSize)) {
+        processed = true;
+
+        // Inputs posted before a task are processed before it
+        size_t first = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (batch[i].inputId == taskMarker) {
+                processBatch(first, i);
+                runTask();
+                first = i + 1;
+            }
+        }
+        processBatch(first, count);
+    }
+    return processed;
+}
+
+void EventLoop::processBatch(size_t first, size_t last) {
+    if (first == last) {
+        return;
+    }
+
+    EventBatchResult result = machine.processInputs(batch.data() + first, last - first);
+    publishedState.store(result.states.back(), memory_order_release);
+    if (resultCallback) {
+        for (int state : result.states) {
+            resultCallback(state);
+        }
+    }
+}
+
+void EventLoop::runTask() {
+    // Marker is pushed after its task, only a push of another thread can still be in progress
+    function<void()> task;
+    while (!tasks.pop(task)) {
+        this_thread::yield();
+    }
+    task();
+}
+
+void EventLoop::run() {
+    const shared_ptr<Clock>& clock = machine.getClock();
+    while (running.load(memory_order_acquire)) {
+        bool busy = drain();
+        if (machine.pollTimers() > 0) {
+            publishedState.store(machine.getCurrentState(), memory_order_release);
+            busy = true;
+        }
+        if (busy) {
+            continue;
+        }
+
+        // Push in progress has claimed its cell but can not be popped yet
+        if (!events.empty()) {
+            this_thread::yield();
+            continue;
+        }
+
+        // Sleep until something is posted or the next delay is due
+        unique_lock<mutex> lock(sleepMutex);
+        sleeping.store(true, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        auto ready = [this] {
+            return !events.empty() || !running.load(memory_order_acquire);
+        };
+        Clock::TimePoint due = machine.nextTimerDue();
+        if (due == Clock::TimePoint::max()) {
+            wakeUp.wait(lock, ready);
+        }
+        else {
+            clock->waitUntil(lock, wakeUp, due, ready);
+        }
+        sleeping.store(false, memory_order_relaxed);
+    }
+
+    // Events posted before stop() are not lost
+    drain();
+}
@@ -0,0 +1,187 @@
+/**
+ * @file EventLoop.h
+ * @brief Header file for the EventLoop class, single thread owning a running machine
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "LockFreeQueue.h"
+#include "MachineDefinition.h"
+#include "MooreMachine.h"
+
+/**
+ * @class EventLoop
+ * @brief Runs the simulation of one machine on its own thread
+ *
+ * Inputs are posted from any thread as (input id, value) pairs through a lock-free
+ * ring, the loop thread is the only one touching the machine. The loop takes inputs
+ * out of the ring in batches and passes each batch to MooreMachine::processInputs(),
+ * so names are not validated and the definition is not checked per event. Delays are
+ * fired by the loop too, the machine does not start its timer thread while the loop
+ * owns it, so the state is never changed from two threads.
+ *
+ * Tasks go through a queue of their own, a marker in the ring keeps them in order
+ * with the inputs posted by the same thread.
+ */
+class EventLoop {
+public:
+    // Called on the loop thread with the state after every processed input, once the batch of the input is processed
+    using ResultCallback = std::function<void(int state)>;
+
+private:
+    // Input id of the marker telling the loop to run the next task
+    static constexpr int taskMarker = -2;
+
+    // Maximum number of inputs passed to the machine at once
+    static constexpr size_t batchSize = 256;
+
+    // Machine owned by the loop while it runs
+    MooreMachine& machine;
+
+    // Definition input names are resolved against, taken when the loop starts
+    std::shared_ptr<const MachineDefinition> definition;
+
+    // Input ids of the definition that may be posted, indexed by id
+    std::vector<bool> validInputs;
+
+    // Inputs and task markers waiting for the loop, values that fit the small string buffer are not allocated
+    BoundedQueue<InputEvent> events;
+
+    // Tasks waiting for the loop, each has its marker in events
+    MpscQueue<std::function<void()>> tasks;
+
+    // Inputs taken out of events at once, used only by the loop thread
+    std::vector<InputEvent> batch;
+
+    // Loop thread sleeps and has to be woken
+    std::atomic<bool> sleeping{false};
+
+    // Loop keeps running while set
+    std::atomic<bool> running{false};
+
+    // State after the last processed event, readable from any thread
+    std::atomic<int> publishedState{-1};
+
+    // Guards sleeping of the loop thread
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+
+    // Loop thread
+    std::thread worker;
+
+    // Called after every processed input
+    ResultCallback resultCallback;
+
+    /**
+     * @brief Appends event and wakes the loop if it sleeps, waits while the queue is full
+     * @param event Event to append
+     */
+    void push(const InputEvent& event);
+
+    /**
+     * @brief Loop of the thread
+     */
+    void run();
+
+    /**
+     * @brief Processes all events waiting in the queue
+     * @return false if nothing was processed
+     */
+    bool drain();
+
+    /**
+     * @brief Passes part of batch to the machine and publishes the results
+     * @param first Index of the first input in batch
+     * @param last Index past the last input
+     */
+    void processBatch(size_t first, size_t last);
+
+    /**
+     * @brief Runs the oldest task, waits for it if its push is still in progress
+     */
+    void runTask();
+
+public:
+    /**
+     * @brief Creates stopped loop
+     * @param machine Machine to run, has to outlive the loop
+     * @param capacity Number of events that may wait for the loop, posting waits when it is reached
+     */
+    explicit EventLoop(MooreMachine& machine, size_t capacity = 65536);
+
+    /**
+     * @brief Stops the loop
+     */
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    /**
+     * @brief Sets callback receiving results, only allowed while the loop is stopped
+     * @param callback Callback, may be empty
+     */
+    void setResultCallback(ResultCallback callback);
+
+    /**
+     * @brief Takes over the machine and starts the loop thread
+     *
+     * Input names are resolved against the definition the machine has now, tasks
+     * must not change the inputs of the machine while the loop runs.
+     */
+    void start();
+
+    /**
+     * @brief Processes events posted so far and stops the loop thread, the owner polls the timers afterwards
+     */
+    void stop();
+
+    /**
+     * @brief Posts input, safe to call from any thread once the loop is started, takes no lock
+     * @param inputName Input name
+     * @param inputValue Input value
+     * @return false if the input is not valid
+     */
+    bool post(const std::string& inputName, const std::string& inputValue);
+
+    /**
+     * @brief Posts input by id, safe to call from any thread, takes no lock
+     * @param inputId Id of the input from findInput()
+     * @param inputValue Input value
+     */
+    void post(int inputId, const std::string& inputValue);
+
+    /**
+     * @brief Looks up id of the input for post(), safe to call from any thread once the loop is started
+     * @param inputName Input name
+     * @return Id of the input, -1 if the input is not valid
+     */
+    int findInput(const std::string& inputName) const;
+
+    /**
+     * @brief Runs task on the loop thread, the task may use the machine
+     * @param task Task to run
+     */
+    void invoke(std::function<void()> task);
+
+    /**
+     * @brief Gets state after the last processed input or delay
+     * @return Index of the state
+     */
+    int getCurrentState() const {
+        return publishedState.load(std::memory_order_acquire);
+    }
+};
+
+#endif // EVENTLOOP_H
@@ -0,0 +1,59 @@
+/**
+ * @file ExprAst.h
+ * @brief Abstract syntax tree of guards and state actions
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#ifndef EXPRAST_H
+#define EXPRAST_H
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "Bytecode.h"
+
+/**
+ * @enum AstKind
+ * @brief Kinds of AST nodes
+ */
+enum class AstKind {
+    Int,      // intValue
+    Bool,     // intValue (0/1)
+    String,   // text
+    Constant, // value, result of constant folding
+    Variable, // text = variable name
+    Unary,    // op (Neg, Not), children[0]
+    Binary,   // op (arithmetic or comparison), children[0], children[1]
+    And,      // children[0] && children[1]
+    Or,       // children[0] || children[1]
+    Call,     // op (Atoi, ValueOf, Defined, Elapsed), text = input name, children = arguments
+    Assign,   // text = variable name, children[0] = value
+    Output,   // text = output name, children[0] = value
+    If,       // children[0] = condition, children[1] = then, optional children[2] = else
+    Block,    // children = statements
+    Discard   // expression statement, children[0]
+};
+
+struct AstNode;
+
+/**
+ * @typedef AstPtr
+ * @brief Shared handle to an immutable tree, cheap to keep in State copies
+ */
+using AstPtr = std::shared_ptr<const AstNode>;
+
+/**
+ * @struct AstNode
+ * @brief One node of the expression tree
+ */
+struct AstNode {
+    AstKind kind;
+    OpCode op = OpCode::Halt;
+    int intValue = 0;
+    std::string text;
+    Value value;
+    std::vector<AstPtr> children;
+};
+
+#endif // EXPRAST_H
@@ -0,0 +1,260 @@
+/**
+ * @file ExprCompiler.cpp
+ * @brief Implementation of the ExprCompiler class, lowers expression trees into bytecode
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#include <iostream>
+#include "ExprCompiler.h"
+#include "ExprOptimizer.h"
+
+using namespace std;
+
+ExprCompiler::ExprCompiler(const SymbolTable& variables, const SymbolTable& outputs) : variables(variables), outputs(outputs) {}
+
+Program ExprCompiler::compile(const AstPtr& ast, const SymbolTable& variables, const SymbolTable& outputs) {
+    if (!ast) {
+        return Program{};
+    }
+
+    ExprCompiler compiler(variables, outputs);
+    if (ast->kind == AstKind::Block) {
+        compiler.statement(*ast);
+    }
+    else {
+        compiler.expression(*ast);
+    }
+
+    compiler.emit(OpCode::Halt);
+    compiler.program.valid = true;
+    return compiler.program;
+}
+
+int ExprCompiler::emit(OpCode op, int arg) {
+    if (op == OpCode::LoadVar) {
+        program.readsVariables = true;
+    }
+    else if (op == OpCode::Elapsed) {
+        program.readsTime = true;
+    }
+    program.code.push_back({op, arg});
+    return static_cast<int>(program.code.size()) - 1;
+}
+
+void ExprCompiler::patch(int jump) {
+    program.code[jump].arg = static_cast<int>(program.code.size());
+}
+
+int ExprCompiler::addString(const string& str) {
+    for (size_t i = 0; i < program.strings.size(); i++) {
+        if (program.strings[i] == str) {
+            return static_cast<int>(i);
+        }
+    }
+    program.strings.push_back(str);
+    return static_cast<int>(program.strings.size()) - 1;
+}
+
+bool ExprCompiler::matchInputComparison(const AstNode& node, string& inputName, OpCode& op, int& constant) {
+    if (node.kind != AstKind::Binary) {
+        return false;
+    }
+
+    OpCode mirrored;
+    switch (node.op) {
+        case OpCode::Eq: mirrored = OpCode::Eq; break;
+        case OpCode::Ne: mirrored = OpCode::Ne; break;
+        case OpCode::Lt: mirrored = OpCode::Gt; break;
+        case OpCode::Le: mirrored = OpCode::Ge; break;
+        case OpCode::Gt: mirrored = OpCode::Lt; break;
+        case OpCode::Ge: mirrored = OpCode::Le; break;
+        default: return false;
+    }
+
+    auto isInputAtoi = [](const AstNode& side) {
+        return side.kind == AstKind::Call && side.op == OpCode::Atoi &&
+               side.children[0]->kind == AstKind::Call && side.children[0]->op == OpCode::ValueOf;
+    };
+    auto isIntConstant = [](const AstNode& side) {
+        return ExprOptimizer::isConstant(side) && ExprOptimizer::constantValue(side).getType() == ValueType::Int;
+    };
+
+    const AstNode& left = *node.children[0];
+    const AstNode& right = *node.children[1];
+    if (isInputAtoi(left) && isIntConstant(right)) {
+        inputName = left.children[0]->text;
+        op = node.op;
+        constant = ExprOptimizer::constantValue(right).asInt();
+        return true;
+    }
+    if (isIntConstant(left) && isInputAtoi(right)) {
+        inputName = right.children[0]->text;
+        op = mirrored;
+        constant = ExprOptimizer::constantValue(left).asInt();
+        return true;
+    }
+    return false;
+}
+
+bool ExprCompiler::fuseInputComparison(const AstNode& node) {
+    string inputName;
+    OpCode op;
+    int constant;
+    if (!matchInputComparison(node, inputName, op, constant)) {
+        return false;
+    }
+
+    // Fused opcodes follow the order of Eq .. Ge in OPCODE_LIST
+    int offset = static_cast<int>(op) - static_cast<int>(OpCode::Eq);
+    OpCode fused = static_cast<OpCode>(static_cast<int>(OpCode::InputEqInt) + offset);
+    program.code.push_back({fused, addString(inputName), constant});
+    return true;
+}
+
+void ExprCompiler::statement(const AstNode& node) {
+    switch (node.kind) {
+        case AstKind::Block:
+            for (const auto& child : node.children) {
+                statement(*child);
+            }
+            break;
+
+        case AstKind::If: {
+            expression(*node.children[0]);
+            int jumpToElse = emit(OpCode::JumpIfFalse);
+            statement(*node.children[1]);
+
+            if (node.children.size() > 2) {
+                int jumpToEnd = emit(OpCode::Jump);
+                patch(jumpToElse);
+                statement(*node.children[2]);
+                patch(jumpToEnd);
+            }
+            else {
+                patch(jumpToElse);
+            }
+            break;
+        }
+
+        case AstKind::Output: {
+            expression(*node.children[0]);
+            int slot = outputs.find(node.text);
+            if (slot == -1) {
+                cout << "Output \"" << node.text << "\" does not exist in machine" << endl;
+                emit(OpCode::Pop);
+            }
+            else {
+                emit(OpCode::Output, slot);
+            }
+            break;
+        }
+
+        case AstKind::Assign: {
+            expression(*node.children[0]);
+            int slot = variables.find(node.text);
+            if (slot == -1) {
+                cout << "Assignment to undefined variable \"" << node.text << "\" is ignored" << endl;
+                emit(OpCode::Pop);
+            }
+            else {
+                emit(OpCode::StoreVar, slot);
+            }
+            break;
+        }
+
+        case AstKind::Discard:
+            expression(*node.children[0]);
+            emit(OpCode::Pop);
+            break;
+
+        default:
+            expression(node);
+            emit(OpCode::Pop);
+            break;
+    }
+}
+
+void ExprCompiler::expression(const AstNode& node) {
+    switch (node.kind) {
+        case AstKind::Int:
+            emit(OpCode::PushInt, node.intValue);
+            break;
+
+        case AstKind::Bool:
+            emit(OpCode::PushBool, node.intValue);
+            break;
+
+        case AstKind::String:
+            emit(OpCode::PushString, addString(node.text));
+            break;
+
+        case AstKind::Constant:
+            program.constants.push_back(node.value);
+            emit(OpCode::PushConst, static_cast<int>(program.constants.size()) - 1);
+            break;
+
+        case AstKind::Variable: {
+            // Unknown identifiers evaluate to their own name
+            int slot = variables.find(node.text);
+            if (slot == -1) {
+                emit(OpCode::PushString, addString(node.text));
+            }
+            else {
+                emit(OpCode::LoadVar, slot);
+            }
+            break;
+        }
+
+        case AstKind::Unary:
+            expression(*node.children[0]);
+            emit(node.op);
+            break;
+
+        case AstKind::Binary:
+            if (fuseInputComparison(node)) {
+                break;
+            }
+            expression(*node.children[0]);
+            expression(*node.children[1]);
+            emit(node.op);
+            break;
+
+        case AstKind::And: {
+            // a && b  =>  a; JumpIfFalse false; b; ToBool; Jump end; false: false; end:
+            expression(*node.children[0]);
+            int jumpToFalse = emit(OpCode::JumpIfFalse);
+            expression(*node.children[1]);
+            emit(OpCode::ToBool);
+            int jumpToEnd = emit(OpCode::Jump);
+            patch(jumpToFalse);
+            emit(OpCode::PushBool, 0);
+            patch(jumpToEnd);
+            break;
+        }
+
+        case AstKind::Or: {
+            // a || b  =>  a; JumpIfFalse rhs; true; Jump end; rhs: b; ToBool; end:
+            expression(*node.children[0]);
+            int jumpToRight = emit(OpCode::JumpIfFalse);
+            emit(OpCode::PushBool, 1);
+            int jumpToEnd = emit(OpCode::Jump);
+            patch(jumpToRight);
+            expression(*node.children[1]);
+            emit(OpCode::ToBool);
+            patch(jumpToEnd);
+            break;
+        }
+
+        case AstKind::Call:
+            for (const auto& argument : node.children) {
+                expression(*argument);
+            }
+            emit(node.op, node.text.empty() ? 0 : addString(node.text));
+            break;
+
+        default:
+            // Statements have no value
+            emit(OpCode::PushInt, -1);
+            break;
+    }
+}
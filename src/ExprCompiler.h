@@ -0,0 +1,105 @@
+/**
+ * @file ExprCompiler.h
+ * @brief Header file for the ExprCompiler class
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#ifndef EXPRCOMPILER_H
+#define EXPRCOMPILER_H
+#pragma once
+
+#include <string>
+#include "Bytecode.h"
+#include "ExprAst.h"
+#include "SymbolTable.h"
+
+/**
+ * @struct CompiledExpr
+ * @brief Parsed tree of a guard or state action together with its bytecode
+ */
+struct CompiledExpr {
+    AstPtr ast; // Cached tree, nullptr if source is empty or invalid
+    Program program; // Bytecode lowered from the tree
+};
+
+/**
+ * @class ExprCompiler
+ * @brief Lowers parsed guards and state actions (ExprParser trees) into bytecode
+ */
+class ExprCompiler {
+public:
+    /**
+     * @brief Compiles parsed guard or state action
+     * @param ast Tree from ExprParser, Block root is compiled as statements, anything else as expression
+     * @param variables Slots of the machine variables
+     * @param outputs Slots of the machine outputs, Output instructions carry the slot
+     * @return Compiled program, not valid if ast is nullptr
+     */
+    static Program compile(const AstPtr& ast, const SymbolTable& variables, const SymbolTable& outputs);
+
+    /**
+     * @brief Matches atoi(valueof("in")) compared with int constant, in either order
+     * @param node Expression node
+     * @param inputName Receives name of the input
+     * @param op Receives comparison opcode (Eq .. Ge) with the input on the left side
+     * @param constant Receives the int constant
+     * @return true if the node matches
+     */
+    static bool matchInputComparison(const AstNode& node, std::string& inputName, OpCode& op, int& constant);
+
+private:
+    // Program being built
+    Program program;
+
+    // Variables the names are resolved against
+    const SymbolTable& variables;
+
+    // Outputs the names are resolved against
+    const SymbolTable& outputs;
+
+    /**
+     * @brief Constructor
+     * @param variables Slots of the machine variables
+     * @param outputs Slots of the machine outputs
+     */
+    ExprCompiler(const SymbolTable& variables, const SymbolTable& outputs);
+
+    /**
+     * @brief Appends instruction to the program
+     * @return Index of the emitted instruction
+     */
+    int emit(OpCode op, int arg = 0);
+
+    /**
+     * @brief Points jump instruction to the end of the program
+     * @param jump Index of the jump instruction
+     */
+    void patch(int jump);
+
+    /**
+     * @brief Adds string constant to the program, reuses existing ones
+     * @return Index of the constant
+     */
+    int addString(const std::string& str);
+
+    /**
+     * @brief Emits code of statement
+     * @param node Statement node
+     */
+    void statement(const AstNode& node);
+
+    /**
+     * @brief Emits fused instruction for atoi(valueof("in")) compared with int constant
+     * @param node Binary comparison node
+     * @return true if the pattern matched and the instruction was emitted
+     */
+    bool fuseInputComparison(const AstNode& node);
+
+    /**
+     * @brief Emits code that leaves value of the expression on the stack
+     * @param node Expression node
+     */
+    void expression(const AstNode& node);
+};
+
+#endif // EXPRCOMPILER_H
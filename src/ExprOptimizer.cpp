@@ -0,0 +1,208 @@
+/**
+ * @file ExprOptimizer.cpp
+ * @brief Implementation of the ExprOptimizer class
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#include "ExprOptimizer.h"
+#include "CodeExecutor.h"
+
+using namespace std;
+
+ExprOptimizer::ExprOptimizer(const unordered_map<string, Value>& constants, const string* inputEvent)
+    : constants(constants), inputEvent(inputEvent) {}
+
+AstPtr ExprOptimizer::optimize(const AstPtr& ast) {
+    if (!ast) {
+        return nullptr;
+    }
+    return fold(ast);
+}
+
+void ExprOptimizer::collectAssigned(const AstPtr& ast, unordered_set<string>& assigned) {
+    if (!ast) {
+        return;
+    }
+    if (ast->kind == AstKind::Assign) {
+        assigned.insert(ast->text);
+    }
+    for (const auto& child : ast->children) {
+        collectAssigned(child, assigned);
+    }
+}
+
+void ExprOptimizer::collectOutputs(const AstPtr& ast, unordered_set<string>& outputs) {
+    if (!ast) {
+        return;
+    }
+    if (ast->kind == AstKind::Output) {
+        outputs.insert(ast->text);
+    }
+    for (const auto& child : ast->children) {
+        collectOutputs(child, outputs);
+    }
+}
+
+bool ExprOptimizer::isConstant(const AstNode& node) {
+    return node.kind == AstKind::Int || node.kind == AstKind::Bool ||
+           node.kind == AstKind::String || node.kind == AstKind::Constant;
+}
+
+Value ExprOptimizer::constantValue(const AstNode& node) {
+    switch (node.kind) {
+        case AstKind::Int:
+            return node.intValue;
+        case AstKind::Bool:
+            return node.intValue != 0;
+        case AstKind::String:
+            return node.text;
+        default:
+            return node.value;
+    }
+}
+
+AstPtr ExprOptimizer::constant(const Value& value) {
+    auto result = make_shared<AstNode>();
+    result->kind = AstKind::Constant;
+    result->value = value;
+    return result;
+}
+
+AstPtr ExprOptimizer::fold(const AstPtr& node) {
+    // Fold children first
+    vector<AstPtr> children;
+    bool changed = false;
+    for (const auto& child : node->children) {
+        children.push_back(fold(child));
+        changed = changed || children.back() != child;
+    }
+
+    auto allConstant = [&children]() {
+        for (const auto& child : children) {
+            if (!isConstant(*child)) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    switch (node->kind) {
+        case AstKind::Variable: {
+            auto it = constants.find(node->text);
+            if (it != constants.end()) {
+                return constant(it->second);
+            }
+            return node;
+        }
+
+        case AstKind::Unary:
+            if (allConstant()) {
+                Value operand = constantValue(*children[0]);
+                if (node->op == OpCode::Not) {
+                    return constant(!operand.asBool());
+                }
+                if (operand.getType() == ValueType::Double) {
+                    return constant(-operand.asDouble());
+                }
+                return constant(-operand.asInt());
+            }
+            break;
+
+        case AstKind::Binary:
+            if (allConstant()) {
+                Value left = constantValue(*children[0]);
+                Value right = constantValue(*children[1]);
+                switch (node->op) {
+                    case OpCode::Eq:
+                    case OpCode::Ne:
+                    case OpCode::Lt:
+                    case OpCode::Le:
+                    case OpCode::Gt:
+                    case OpCode::Ge:
+                        return constant(CodeExecutor::compareExprValues(left, right, node->op));
+
+                    case OpCode::Div:
+                    case OpCode::Mod:
+                        // Keep division by zero for runtime, it reports the error
+                        if (right.getType() != ValueType::Double && right.asInt() == 0) {
+                            break;
+                        }
+                        return constant(CodeExecutor::arithmetic(left, right, node->op));
+
+                    default:
+                        return constant(CodeExecutor::arithmetic(left, right, node->op));
+                }
+            }
+            break;
+
+        case AstKind::And:
+        case AstKind::Or: {
+            bool isAnd = node->kind == AstKind::And;
+            if (isConstant(*children[0])) {
+                bool left = constantValue(*children[0]).asBool();
+                // false && x, true || x
+                if (left != isAnd) {
+                    return constant(left);
+                }
+                // true && x, false || x
+                if (isConstant(*children[1])) {
+                    return constant(constantValue(*children[1]).asBool());
+                }
+            }
+            break;
+        }
+
+        case AstKind::Call:
+            if (node->op == OpCode::Atoi && allConstant()) {
+                return constant(constantValue(*children[0]).asInt());
+            }
+            // Guard is evaluated only for its own input, so other inputs are never defined there
+            if (inputEvent && node->op == OpCode::Defined) {
+                return constant(node->text == *inputEvent);
+            }
+            if (inputEvent && node->op == OpCode::ValueOf && node->text != *inputEvent) {
+                return constant(string());
+            }
+            break;
+
+        case AstKind::If:
+            if (isConstant(*children[0])) {
+                if (constantValue(*children[0]).asBool()) {
+                    return children[1];
+                }
+                if (children.size() > 2) {
+                    return children[2];
+                }
+                auto empty = make_shared<AstNode>();
+                empty->kind = AstKind::Block;
+                return empty;
+            }
+            break;
+
+        case AstKind::Block: {
+            // Drop statements that do nothing
+            vector<AstPtr> statements;
+            for (const auto& child : children) {
+                bool emptyBlock = child->kind == AstKind::Block && child->children.empty();
+                bool constantDiscard = child->kind == AstKind::Discard && isConstant(*child->children[0]);
+                if (!emptyBlock && !constantDiscard) {
+                    statements.push_back(child);
+                }
+            }
+            changed = changed || statements.size() != children.size();
+            children = statements;
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    if (!changed) {
+        return node;
+    }
+
+    auto result = make_shared<AstNode>(*node);
+    result->children = children;
+    return result;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file ExprOptimizer.h
+ * @brief Header file for the ExprOptimizer class
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#ifndef EXPROPTIMIZER_H
+#define EXPROPTIMIZER_H
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include "ExprAst.h"
+#include "Value.h"
+
+/**
+ * @class ExprOptimizer
+ * @brief Constant folding pass over parsed guards and state actions
+ *
+ * Folds operators with constant operands, replaces variables that are never
+ * assigned by their initial value and, for guards, resolves defined()/valueof()
+ * of inputs other than the one the transition reacts to.
+ */
+class ExprOptimizer {
+private:
+    // Variables that are never assigned, with their value
+    const std::unordered_map<std::string, Value>& constants;
+
+    // Input the guard is evaluated for, nullptr for state actions
+    const std::string* inputEvent;
+
+    /**
+     * @brief Folds node and its children
+     * @param node Node to fold
+     * @return Folded node, the same node if nothing changed
+     */
+    AstPtr fold(const AstPtr& node);
+
+    /**
+     * @brief Creates constant node
+     * @param value Value of the node
+     * @return Constant node
+     */
+    static AstPtr constant(const Value& value);
+
+public:
+    /**
+     * @brief Constructor
+     * @param constants Variables that are never assigned, with their value
+     * @param inputEvent Input the guard is evaluated for, nullptr for state actions
+     */
+    ExprOptimizer(const std::unordered_map<std::string, Value>& constants, const std::string* inputEvent = nullptr);
+
+    /**
+     * @brief Optimizes the tree
+     * @param ast Tree to optimize, can be nullptr
+     * @return Optimized tree, original tree is left untouched
+     */
+    AstPtr optimize(const AstPtr& ast);
+
+    /**
+     * @brief Collects names of all variables assigned in the tree
+     * @param ast Tree to search, can be nullptr
+     * @param assigned Set the names are added to
+     */
+    static void collectAssigned(const AstPtr& ast, std::unordered_set<std::string>& assigned);
+
+    /**
+     * @brief Collects names of all outputs written in the tree
+     * @param ast Tree to search, can be nullptr
+     * @param outputs Set the names are added to
+     */
+    static void collectOutputs(const AstPtr& ast, std::unordered_set<std::string>& outputs);
+
+    /**
+     * @brief Checks if node is a literal or folded constant
+     * @param node Node to check
+     * @return true if value of the node is known
+     */
+    static bool isConstant(const AstNode& node);
+
+    /**
+     * @brief Gets value of constant node
+     * @param node Node for which isConstant is true
+     * @return Value of the node
+     */
+    static Value constantValue(const AstNode& node);
+};
+
+#endif // EXPROPTIMIZER_H
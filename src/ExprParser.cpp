@@ -0,0 +1,367 @@
+/**
+ * @file ExprParser.cpp
+ * @brief Implementation of the ExprParser class, builds AST from guards and state actions
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#include <iostream>
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdlib>
+#include <tuple>
+#include "ExprParser.h"
+
+using namespace std;
+
+ExprParser::ExprParser(const string& source) : source(source) {
+    tokenize();
+}
+
+AstPtr ExprParser::parseGuard(const string& source) {
+    ExprParser parser(source);
+    if (parser.peek().type == TokenType::End) {
+        return nullptr;
+    }
+
+    AstPtr guard = parser.expression();
+    parser.expect("");
+    return parser.failed ? nullptr : guard;
+}
+
+AstPtr ExprParser::parseAction(const string& source) {
+    ExprParser parser(source);
+    if (parser.peek().type == TokenType::End) {
+        return nullptr;
+    }
+
+    AstPtr action = parser.statements("");
+    return parser.failed ? nullptr : action;
+}
+
+void ExprParser::tokenize() {
+    size_t i = 0;
+    while (i < source.size()) {
+        char ch = source[i];
+
+        if (isspace(static_cast<unsigned char>(ch))) {
+            i++;
+        }
+
+        // Integer literal
+        else if (isdigit(static_cast<unsigned char>(ch))) {
+            size_t start = i;
+            while (i < source.size() && isdigit(static_cast<unsigned char>(source[i]))) {
+                i++;
+            }
+            tokens.push_back({TokenType::Int, source.substr(start, i - start)});
+        }
+
+        // Identifier or keyword
+        else if (isalpha(static_cast<unsigned char>(ch)) || ch == '_') {
+            size_t start = i;
+            while (i < source.size() && (isalnum(static_cast<unsigned char>(source[i])) || source[i] == '_')) {
+                i++;
+            }
+            tokens.push_back({TokenType::Ident, source.substr(start, i - start)});
+        }
+
+        // String literal, \" and \\ can be escaped
+        else if (ch == '"') {
+            string text;
+            i++;
+            while (i < source.size() && source[i] != '"') {
+                if (source[i] == '\\' && i + 1 < source.size()) {
+                    i++;
+                }
+                text += source[i++];
+            }
+            if (i >= source.size()) {
+                error("unterminated string literal");
+                break;
+            }
+            i++;
+            tokens.push_back({TokenType::String, text});
+        }
+
+        // Operators and punctuation
+        else {
+            static const vector<string> twoCharOps = {"==", "!=", "<=", ">=", "&&", "||"};
+            string op(1, ch);
+            if (i + 1 < source.size()) {
+                string pair = source.substr(i, 2);
+                if (find(twoCharOps.begin(), twoCharOps.end(), pair) != twoCharOps.end()) {
+                    op = pair;
+                }
+            }
+            if (op.size() == 1 && string("(){}<>+-*/%!=,;").find(ch) == string::npos) {
+                error(string("unexpected character '") + ch + "'");
+                break;
+            }
+            i += op.size();
+            tokens.push_back({TokenType::Op, op});
+        }
+    }
+
+    tokens.push_back({TokenType::End, ""});
+}
+
+void ExprParser::error(const string& message) {
+    // Report only the first error, the rest is usually its consequence
+    if (!failed) {
+        cout << "Failed to compile expression \"" << source << "\": " << message << endl;
+    }
+    failed = true;
+}
+
+const ExprParser::Token& ExprParser::peek(size_t offset) const {
+    size_t index = min(pos + offset, tokens.size() - 1);
+    return tokens[index];
+}
+
+bool ExprParser::check(const string& text, size_t offset) const {
+    const Token& token = peek(offset);
+    if (text.empty()) {
+        return token.type == TokenType::End;
+    }
+    return (token.type == TokenType::Op || token.type == TokenType::Ident) && token.text == text;
+}
+
+bool ExprParser::accept(const string& text) {
+    if (check(text)) {
+        if (peek().type != TokenType::End) {
+            pos++;
+        }
+        return true;
+    }
+    return false;
+}
+
+void ExprParser::expect(const string& text) {
+    if (!accept(text)) {
+        error("expected " + (text.empty() ? string("end of expression") : "'" + text + "'") +
+              " but found '" + peek().text + "'");
+    }
+}
+
+shared_ptr<AstNode> ExprParser::node(AstKind kind, OpCode op) {
+    auto result = make_shared<AstNode>();
+    result->kind = kind;
+    result->op = op;
+    return result;
+}
+
+string ExprParser::stringArgument() {
+    if (peek().type != TokenType::String) {
+        error("expected string literal but found '" + peek().text + "'");
+        return "";
+    }
+    return tokens[pos++].text;
+}
+
+AstPtr ExprParser::statements(const string& terminator) {
+    auto block = node(AstKind::Block);
+    while (!failed && !check(terminator) && peek().type != TokenType::End) {
+        AstPtr stmt = statement();
+        if (stmt) {
+            block->children.push_back(stmt);
+        }
+    }
+    expect(terminator);
+    return block;
+}
+
+AstPtr ExprParser::statement() {
+    // Empty statement
+    if (accept(";")) {
+        return nullptr;
+    }
+
+    // Nested block
+    if (accept("{")) {
+        return statements("}");
+    }
+
+    // if (condition) statement [else statement], condition can be also in {}
+    if (accept("if")) {
+        string closing = ")";
+        if (accept("{")) {
+            closing = "}";
+        }
+        else {
+            expect("(");
+        }
+
+        auto ifNode = node(AstKind::If);
+        ifNode->children.push_back(expression());
+        expect(closing);
+
+        AstPtr body = statement();
+        ifNode->children.push_back(body ? body : node(AstKind::Block));
+        if (accept("else")) {
+            AstPtr elseBody = statement();
+            ifNode->children.push_back(elseBody ? elseBody : node(AstKind::Block));
+        }
+        return ifNode;
+    }
+
+    // output("name", value)
+    if (check("output") && check("(", 1)) {
+        pos += 2;
+        auto outputNode = node(AstKind::Output);
+        outputNode->text = stringArgument();
+        expect(",");
+        outputNode->children.push_back(expression());
+        expect(")");
+        accept(";");
+        return outputNode;
+    }
+
+    // variable = value
+    if (peek().type == TokenType::Ident && check("=", 1)) {
+        auto assignNode = node(AstKind::Assign);
+        assignNode->text = tokens[pos].text;
+        pos += 2;
+        assignNode->children.push_back(expression());
+        accept(";");
+        return assignNode;
+    }
+
+    // Any other expression, result is thrown away
+    auto discardNode = node(AstKind::Discard);
+    discardNode->children.push_back(expression());
+    accept(";");
+    return discardNode;
+}
+
+int ExprParser::binaryPrecedence(OpCode& op, AstKind& kind) const {
+    static const vector<tuple<string, OpCode, AstKind, int>> binaryOps = {
+        {"||", OpCode::Halt, AstKind::Or, 1},
+        {"&&", OpCode::Halt, AstKind::And, 2},
+        {"==", OpCode::Eq, AstKind::Binary, 3}, {"!=", OpCode::Ne, AstKind::Binary, 3},
+        {"<", OpCode::Lt, AstKind::Binary, 3}, {"<=", OpCode::Le, AstKind::Binary, 3},
+        {">", OpCode::Gt, AstKind::Binary, 3}, {">=", OpCode::Ge, AstKind::Binary, 3},
+        {"+", OpCode::Add, AstKind::Binary, 4}, {"-", OpCode::Sub, AstKind::Binary, 4},
+        {"*", OpCode::Mul, AstKind::Binary, 5}, {"/", OpCode::Div, AstKind::Binary, 5},
+        {"%", OpCode::Mod, AstKind::Binary, 5}
+    };
+
+    if (peek().type != TokenType::Op) {
+        return 0;
+    }
+    for (const auto& [text, opCode, opKind, precedence] : binaryOps) {
+        if (peek().text == text) {
+            op = opCode;
+            kind = opKind;
+            return precedence;
+        }
+    }
+    return 0;
+}
+
+AstPtr ExprParser::expression(int minPrecedence) {
+    AstPtr left = prefix();
+
+    OpCode op;
+    AstKind kind;
+    int precedence;
+    while (!failed && (precedence = binaryPrecedence(op, kind)) >= minPrecedence) {
+        pos++;
+        // All operators are left associative
+        auto binaryNode = node(kind, op);
+        binaryNode->children.push_back(left);
+        binaryNode->children.push_back(expression(precedence + 1));
+        left = binaryNode;
+    }
+    return left;
+}
+
+AstPtr ExprParser::prefix() {
+    if (accept("!")) {
+        auto notNode = node(AstKind::Unary, OpCode::Not);
+        notNode->children.push_back(prefix());
+        return notNode;
+    }
+    if (accept("-")) {
+        auto negNode = node(AstKind::Unary, OpCode::Neg);
+        negNode->children.push_back(prefix());
+        return negNode;
+    }
+    return primary();
+}
+
+AstPtr ExprParser::primary() {
+    const Token& token = peek();
+
+    switch (token.type) {
+        case TokenType::Int: {
+            auto intNode = node(AstKind::Int);
+            long value = strtol(token.text.c_str(), nullptr, 10);
+            intNode->intValue = static_cast<int>(min<long>(value, INT_MAX));
+            pos++;
+            return intNode;
+        }
+
+        case TokenType::String: {
+            auto stringNode = node(AstKind::String);
+            stringNode->text = token.text;
+            pos++;
+            return stringNode;
+        }
+
+        case TokenType::Ident:
+            break;
+
+        case TokenType::Op:
+            if (accept("(")) {
+                AstPtr inner = expression();
+                expect(")");
+                return inner;
+            }
+            error("unexpected '" + token.text + "'");
+            return node(AstKind::Int);
+
+        case TokenType::End:
+            error("unexpected end of expression");
+            return node(AstKind::Int);
+    }
+
+    string name = token.text;
+    pos++;
+
+    if (name == "true" || name == "false") {
+        auto boolNode = node(AstKind::Bool);
+        boolNode->intValue = name == "true";
+        return boolNode;
+    }
+
+    // Plain identifier, variable value or its own name if no such variable exists
+    if (!accept("(")) {
+        auto varNode = node(AstKind::Variable);
+        varNode->text = name;
+        return varNode;
+    }
+
+    // Built-in functions
+    auto callNode = node(AstKind::Call);
+    if (name == "atoi") {
+        callNode->op = OpCode::Atoi;
+        callNode->children.push_back(expression());
+    }
+    else if (name == "valueof") {
+        callNode->op = OpCode::ValueOf;
+        callNode->text = stringArgument();
+    }
+    else if (name == "defined") {
+        callNode->op = OpCode::Defined;
+        callNode->text = stringArgument();
+    }
+    else if (name == "elapsed") {
+        callNode->op = OpCode::Elapsed;
+    }
+    else {
+        error("unknown function " + name);
+    }
+    expect(")");
+    return callNode;
+}
@@ -0,0 +1,118 @@
+/**
+ * @file ExprParser.h
+ * @brief Header file for the ExprParser class
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#ifndef EXPRPARSER_H
+#define EXPRPARSER_H
+#pragma once
+
+#include <string>
+#include <vector>
+#include "ExprAst.h"
+
+/**
+ * @class ExprParser
+ * @brief Recursive descent (Pratt for operators) parser of guards and state actions
+ *
+ * Supported language:
+ *   action := { statement }
+ *   statement := "if" "(" expr ")" statement [ "else" statement ] | name "=" expr | output("out", expr)
+ *              | "{" action "}" | expr | ";"
+ *   expr := || && comparisons (== != < <= > >=), + - * / %, unary ! -, literals, variables
+ *           and built-ins atoi(expr), valueof("in"), defined("in"), elapsed()
+ */
+class ExprParser {
+public:
+    /**
+     * @brief Parses transition guard (single expression)
+     * @param source Guard source, content of [] in transition
+     * @return Tree of the guard, nullptr if source is empty or has errors
+     */
+    static AstPtr parseGuard(const std::string& source);
+
+    /**
+     * @brief Parses state action (list of statements)
+     * @param source Output expression of the state
+     * @return Block node with statements, nullptr if source is empty or has errors
+     */
+    static AstPtr parseAction(const std::string& source);
+
+private:
+    /**
+     * @enum TokenType
+     * @brief Kinds of lexical tokens
+     */
+    enum class TokenType { Int, String, Ident, Op, End };
+
+    /**
+     * @struct Token
+     * @brief Lexical token with its text
+     */
+    struct Token {
+        TokenType type;
+        std::string text;
+    };
+
+    // Source being parsed, used in error messages
+    std::string source;
+
+    // Tokens of the source
+    std::vector<Token> tokens;
+
+    // Position of the current token
+    size_t pos = 0;
+
+    // Set when any error occurs
+    bool failed = false;
+
+    /**
+     * @brief Constructor, tokenizes the source
+     * @param source Source to parse
+     */
+    explicit ExprParser(const std::string& source);
+
+    /**
+     * @brief Splits source into tokens
+     */
+    void tokenize();
+
+    /**
+     * @brief Reports parse error
+     * @param message Description of the error
+     */
+    void error(const std::string& message);
+
+    const Token& peek(size_t offset = 0) const;
+    bool check(const std::string& text, size_t offset = 0) const;
+    bool accept(const std::string& text);
+    void expect(const std::string& text);
+
+    /**
+     * @brief Creates new node
+     */
+    static std::shared_ptr<AstNode> node(AstKind kind, OpCode op = OpCode::Halt);
+
+    /**
+     * @brief Parses string literal argument of a built-in function
+     * @return Content of the literal
+     */
+    std::string stringArgument();
+
+    /**
+     * @brief Binding power of binary operator at current position
+     * @param op Filled with opcode of the operator
+     * @param kind Filled with node kind of the operator
+     * @return Precedence, 0 if there is no binary operator
+     */
+    int binaryPrecedence(OpCode& op, AstKind& kind) const;
+
+    AstPtr statements(const std::string& terminator);
+    AstPtr statement();
+    AstPtr expression(int minPrecedence = 1);
+    AstPtr prefix();
+    AstPtr primary();
+};
+
+#endif // EXPRPARSER_H
@@ -0,0 +1,151 @@
+/**
+ * @file GuardBatch.cpp
+ * @brief Implementation of the GuardBatch class
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#include "GuardBatch.h"
+#include "CodeExecutor.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define GUARD_BATCH_SSE2
+#endif
+
+using namespace std;
+
+GuardBatch::GuardBatch(const string& inputName, const vector<int>& values)
+    : inputName(inputName), values(values) {}
+
+vector<uint64_t> GuardBatch::evaluate(MachineInstance& machine, const CompiledExpr& guard,
+                                      const string& inputName, const vector<int>& values) {
+    size_t words = (values.size() + 63) / 64;
+    vector<uint64_t> mask(words, 0);
+
+    // Transition without guard can always be taken
+    if (guard.program.empty()) {
+        mask.assign(words, ~uint64_t(0));
+    }
+    else if (!guard.ast || !GuardBatch(inputName, values).evaluateMask(*guard.ast, mask)) {
+        // Run the bytecode for every value, same as processInput does
+        mask.assign(words, 0);
+        string inputValue;
+        for (size_t i = 0; i < values.size(); i++) {
+            inputValue = to_string(values[i]);
+            CodeExecutor executor(machine, inputName, inputValue);
+            if (executor.executeTransitionBoolExpr(guard.program)) {
+                mask[i / 64] |= uint64_t(1) << (i % 64);
+            }
+        }
+    }
+
+    // Bits past the last value stay clear
+    if (values.size() % 64 != 0) {
+        mask.back() &= (uint64_t(1) << (values.size() % 64)) - 1;
+    }
+    return mask;
+}
+
+bool GuardBatch::evaluateMask(const AstNode& node, vector<uint64_t>& mask) {
+    string name;
+    OpCode op;
+    int constant;
+    if (ExprCompiler::matchInputComparison(node, name, op, constant)) {
+        if (name == inputName) {
+            compareColumn(op, constant, mask);
+        }
+        else {
+            // Other inputs are not defined, atoi of their value is 0
+            bool result = CodeExecutor::compareExprValues(0, constant, op);
+            mask.assign(mask.size(), result ? ~uint64_t(0) : 0);
+        }
+        return true;
+    }
+
+    switch (node.kind) {
+        case AstKind::Bool:
+            mask.assign(mask.size(), node.intValue ? ~uint64_t(0) : 0);
+            return true;
+
+        case AstKind::Constant:
+            if (node.value.getType() != ValueType::Bool) {
+                return false;
+            }
+            mask.assign(mask.size(), node.value.asBool() ? ~uint64_t(0) : 0);
+            return true;
+
+        case AstKind::Unary:
+            if (node.op != OpCode::Not || !evaluateMask(*node.children[0], mask)) {
+                return false;
+            }
+            for (auto& word : mask) {
+                word = ~word;
+            }
+            return true;
+
+        case AstKind::And:
+        case AstKind::Or: {
+            vector<uint64_t> right(mask.size());
+            if (!evaluateMask(*node.children[0], mask) || !evaluateMask(*node.children[1], right)) {
+                return false;
+            }
+            for (size_t i = 0; i < mask.size(); i++) {
+                mask[i] = node.kind == AstKind::And ? mask[i] & right[i] : mask[i] | right[i];
+            }
+            return true;
+        }
+
+        default:
+            return false;
+    }
+}
+
+void GuardBatch::compareColumn(OpCode op, int constant, vector<uint64_t>& mask) {
+    // Ne, Le and Ge are computed as negation of Eq, Gt and Lt
+    bool negate = op == OpCode::Ne || op == OpCode::Le || op == OpCode::Ge;
+    OpCode base = op == OpCode::Ne ? OpCode::Eq : op == OpCode::Le ? OpCode::Gt : op == OpCode::Ge ? OpCode::Lt : op;
+
+    mask.assign(mask.size(), 0);
+    const int* data = values.data();
+    size_t count = values.size();
+    size_t i = 0;
+
+#ifdef GUARD_BATCH_SSE2
+    // Four values per compare, 64 bit word is filled by sixteen of them
+    __m128i constants = _mm_set1_epi32(constant);
+    for (; i + 4 <= count; i += 4) {
+        __m128i column = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i result;
+        if (base == OpCode::Eq) {
+            result = _mm_cmpeq_epi32(column, constants);
+        }
+        else if (base == OpCode::Gt) {
+            result = _mm_cmpgt_epi32(column, constants);
+        }
+        else {
+            result = _mm_cmplt_epi32(column, constants);
+        }
+        uint64_t bits = static_cast<uint64_t>(_mm_movemask_ps(_mm_castsi128_ps(result)));
+        if (negate) {
+            bits ^= 0xF;
+        }
+        mask[i / 64] |= bits << (i % 64);
+    }
+#endif
+
+    for (; i < count; i++) {
+        bool result;
+        if (base == OpCode::Eq) {
+            result = data[i] == constant;
+        }
+        else if (base == OpCode::Gt) {
+            result = data[i] > constant;
+        }
+        else {
+            result = data[i] < constant;
+        }
+        if (result != negate) {
+            mask[i / 64] |= uint64_t(1) << (i % 64);
+        }
+    }
+}
@@ -0,0 +1,70 @@
+/**
+ * @file GuardBatch.h
+ * @brief Header file for the GuardBatch class
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#ifndef GUARDBATCH_H
+#define GUARDBATCH_H
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ExprCompiler.h"
+
+class MachineInstance;
+
+/**
+ * @class GuardBatch
+ * @brief Evaluates compiled guard over a column of integer input values at once
+ *
+ * Comparisons of atoi(valueof("in")) with int constants combined by &&, || and !
+ * are evaluated with SIMD compares into bitmasks, any other guard falls back
+ * to running its bytecode for every value.
+ */
+class GuardBatch {
+public:
+    /**
+     * @brief Evaluates guard of a transition for every value of its input
+     * @param machine Running machine the guard belongs to, variables are read from it
+     * @param guard Compiled guard of the transition
+     * @param inputName Input event of the transition
+     * @param values Values of the input
+     * @return Bitmask, bit i % 64 of word i / 64 is set if the guard holds for values[i]
+     */
+    static std::vector<uint64_t> evaluate(MachineInstance& machine, const CompiledExpr& guard,
+                                          const std::string& inputName, const std::vector<int>& values);
+
+private:
+    // Guard is evaluated for input of this name
+    const std::string& inputName;
+
+    // Column of input values
+    const std::vector<int>& values;
+
+    /**
+     * @brief Constructor
+     * @param inputName Input event of the transition
+     * @param values Values of the input
+     */
+    GuardBatch(const std::string& inputName, const std::vector<int>& values);
+
+    /**
+     * @brief Computes bitmask of the expression over all values
+     * @param node Expression node
+     * @param mask Receives the bitmask, has one bit per value
+     * @return false if the expression can not be evaluated as bitmask
+     */
+    bool evaluateMask(const AstNode& node, std::vector<uint64_t>& mask);
+
+    /**
+     * @brief Compares every value with the constant
+     * @param op Comparison opcode (Eq .. Ge), value is on the left side
+     * @param constant Int constant
+     * @param mask Receives the bitmask
+     */
+    void compareColumn(OpCode op, int constant, std::vector<uint64_t>& mask);
+};
+
+#endif // GUARDBATCH_H
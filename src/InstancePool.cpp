@@ -0,0 +1,406 @@
+/**
+ * @file InstancePool.cpp
+ * @brief Implementation of the InstancePool class
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#include <algorithm>
+#include <iostream>
+#include "CodeExecutor.h"
+#include "InstancePool.h"
+
+using namespace std;
+
+InstancePool::InstancePool(shared_ptr<const MachineDefinition> definition, shared_ptr<Clock> clock)
+    : definition(move(definition)), clock(move(clock)) {
+}
+
+void InstancePool::grow() {
+    int newCapacity = capacity == 0 ? 16 : capacity * 2;
+    int variableCount = static_cast<int>(definition->variables.size());
+    int outputCount = definition->outputSlots.size();
+
+    // Columns keep their slot order, only the distance between them changes
+    vector<Value> newVariables(static_cast<size_t>(variableCount) * newCapacity);
+    for (int slot = 0; slot < variableCount; slot++) {
+        for (int i = 0; i < count; i++) {
+            newVariables[slot * newCapacity + i] = move(variables[slot * capacity + i]);
+        }
+    }
+
+    vector<string> newOutputs(static_cast<size_t>(outputCount) * newCapacity);
+    for (int slot = 0; slot < outputCount; slot++) {
+        for (int i = 0; i < count; i++) {
+            newOutputs[slot * newCapacity + i] = move(outputs[slot * capacity + i]);
+        }
+    }
+
+    variables = move(newVariables);
+    outputs = move(newOutputs);
+    states.reserve(newCapacity);
+    pendingStates.reserve(newCapacity);
+    pendingDue.reserve(newCapacity);
+    pendingInputs.reserve(newCapacity);
+    pendingValues.reserve(newCapacity);
+    enteredAt.reserve(newCapacity);
+    capacity = newCapacity;
+}
+
+int InstancePool::add() {
+    if (count == capacity) {
+        grow();
+    }
+
+    int id = count++;
+    states.push_back(definition->startState);
+    pendingStates.push_back(-1);
+    pendingDue.emplace_back();
+    pendingInputs.push_back(-1);
+    pendingValues.emplace_back();
+    enteredAt.push_back(clock->now());
+    for (size_t slot = 0; slot < definition->variables.size(); slot++) {
+        variables[slot * capacity + id] = definition->variables[slot].value;
+    }
+    return id;
+}
+
+InstanceView InstancePool::view(int id) {
+    InstanceView result;
+    result.definition = definition.get();
+    result.currentState = &states[id];
+    result.variables = variables.data() + id;
+    result.variableStride = capacity;
+    result.outputs = outputs.data() + id;
+    result.outputStride = capacity;
+    result.enteredAt = &enteredAt[id];
+    result.clock = clock.get();
+    return result;
+}
+
+void InstancePool::start(int id) {
+    if (states[id] == -1) {
+        return;
+    }
+    InstanceView instance = view(id);
+    enteredAt[id] = clock->now();
+    CodeExecutor executor(instance, "", "");
+    executor.executeStateExpr(definition->states[states[id]].action.program);
+    entered(id);
+}
+
+void InstancePool::startAll() {
+    for (int id = 0; id < count; id++) {
+        start(id);
+    }
+}
+
+void InstancePool::take(int id, const CompiledTransition& transition, CodeExecutor& executor, int inputId, const string& inputValue) {
+    int delay = view(id).getDelayValue(transition);
+    if (delay == -1) {
+        pendingStates[id] = -1;
+        view(id).enterState(transition.nextState, executor);
+        entered(id);
+        return;
+    }
+    pendingStates[id] = transition.nextState;
+    pendingDue[id] = clock->now() + chrono::milliseconds(delay);
+    pendingInputs[id] = inputId;
+    pendingValues[id] = inputValue;
+}
+
+void InstancePool::entered(int id) {
+    // Delay-only transition of the new state starts right away
+    int nextState;
+    int delay = view(id).getEntryDelay(nextState);
+    if (delay != -1) {
+        pendingStates[id] = nextState;
+        pendingDue[id] = clock->now() + chrono::milliseconds(delay);
+        pendingInputs[id] = -1;
+        pendingValues[id].clear();
+    }
+}
+
+bool InstancePool::processInput(int id, const string& inputName, const string& inputValue) {
+    if (states[id] == -1) {
+        return false;
+    }
+
+    InstanceView instance = view(id);
+    instance.resetOutputs();
+    CodeExecutor executor(instance, inputName, inputValue);
+    int inputId = definition->inputSlots.find(inputName);
+    const CompiledTransition* transition = definition->selectTransition(states[id], inputId, [&](const CompiledTransition& candidate) {
+        return executor.executeTransitionBoolExpr(candidate.guard.program);
+    });
+    if (!transition) {
+        return false;
+    }
+    take(id, *transition, executor, inputId, inputValue);
+    return true;
+}
+
+int InstancePool::processInput(const string& inputName, const string& inputValue) {
+    int inputId = definition->inputSlots.find(inputName);
+
+    // Results of guards shared by all instances, -1 until evaluated
+    vector<signed char> sharedResults(definition->transitionCount, -1);
+
+    int taken = 0;
+    for (int id = 0; id < count; id++) {
+        if (states[id] == -1) {
+            continue;
+        }
+
+        InstanceView instance = view(id);
+        instance.resetOutputs();
+        CodeExecutor executor(instance, inputName, inputValue);
+        const CompiledTransition* transition = definition->selectTransition(states[id], inputId, [&](const CompiledTransition& candidate) {
+            const Program& guard = candidate.guard.program;
+            if (guard.readsVariables || guard.readsTime) {
+                return executor.executeTransitionBoolExpr(guard);
+            }
+            signed char& result = sharedResults[candidate.id];
+            if (result == -1) {
+                result = executor.executeTransitionBoolExpr(guard) ? 1 : 0;
+            }
+            return result == 1;
+        });
+        if (transition) {
+            take(id, *transition, executor, inputId, inputValue);
+            taken++;
+        }
+    }
+    return taken;
+}
+
+int InstancePool::getPendingDelay(int id) const {
+    if (pendingStates[id] == -1) {
+        return -1;
+    }
+    return static_cast<int>(max<long long>(0, chrono::duration_cast<chrono::milliseconds>(pendingDue[id] - clock->now()).count()));
+}
+
+void InstancePool::completePending(int id) {
+    int target = pendingStates[id];
+    if (target == -1) {
+        return;
+    }
+    pendingStates[id] = -1;
+
+    // Action of the target sees the input that took the transition
+    int inputId = pendingInputs[id];
+    const string& inputName = inputId == -1 ? string() : definition->inputSlots.name(inputId);
+    InstanceView instance = view(id);
+    instance.resetOutputs();
+    CodeExecutor executor(instance, inputName, pendingValues[id]);
+    instance.enterState(target, executor);
+    entered(id);
+}
+
+int InstancePool::completeDue() {
+    Clock::TimePoint now = clock->now();
+    int fired = 0;
+    for (int id = 0; id < count; id++) {
+        if (pendingStates[id] != -1 && pendingDue[id] <= now) {
+            completePending(id);
+            fired++;
+        }
+    }
+    return fired;
+}
+
+Clock::TimePoint InstancePool::nextDue() const {
+    Clock::TimePoint due = Clock::TimePoint::max();
+    for (int id = 0; id < count; id++) {
+        if (pendingStates[id] != -1) {
+            due = min(due, pendingDue[id]);
+        }
+    }
+    return due;
+}
+
+void InstancePool::cancelPending(int id) {
+    pendingStates[id] = -1;
+}
+
+string InstancePool::getCurrentOutput(int id) const {
+    string result;
+    for (int slot = 0; slot < definition->outputSlots.size(); slot++) {
+        result += definition->outputSlots.name(slot) + ":" + getOutput(id, slot);
+    }
+    return result;
+}
+
+// Column whose values do not share one type, every value carries its own
+static const uint8_t mixedColumn = 0xff;
+
+string InstancePool::saveSnapshot() const {
+    string data;
+    SnapshotWriter writer(data);
+    writer.header(Snapshot::Kind::Pool, *definition);
+    writer.u32(static_cast<uint32_t>(count));
+    writer.i32s(states.data(), count);
+    writer.i32s(pendingStates.data(), count);
+    writer.i32s(pendingInputs.data(), count);
+
+    // Waiting transitions are saved with the time they have left in milliseconds
+    Clock::TimePoint now = clock->now();
+    vector<int> remaining(count, 0);
+    for (int i = 0; i < count; i++) {
+        if (pendingStates[i] != -1) {
+            remaining[i] = static_cast<int>(max<long long>(0, chrono::duration_cast<chrono::milliseconds>(pendingDue[i] - now).count()));
+        }
+    }
+    writer.i32s(remaining.data(), count);
+    for (int i = 0; i < count; i++) {
+        if (pendingStates[i] != -1) {
+            writer.text(pendingValues[i]);
+        }
+    }
+
+    // Time in the current state in microseconds
+    for (int i = 0; i < count; i++) {
+        writer.u64(static_cast<uint64_t>(chrono::duration_cast<chrono::microseconds>(now - enteredAt[i]).count()));
+    }
+
+    // Variables keep their declared type, so a column is normally written without types
+    int variableCount = static_cast<int>(definition->variables.size());
+    writer.u32(static_cast<uint32_t>(variableCount));
+    for (int slot = 0; slot < variableCount; slot++) {
+        const Value* column = variables.data() + static_cast<size_t>(slot) * capacity;
+        ValueType type = count > 0 ? column[0].getType() : ValueType::Int;
+        bool uniform = true;
+        for (int i = 1; i < count && uniform; i++) {
+            uniform = column[i].getType() == type;
+        }
+
+        writer.u8(uniform ? static_cast<uint8_t>(type) : mixedColumn);
+        for (int i = 0; i < count; i++) {
+            if (uniform) {
+                writer.valuePayload(column[i]);
+            }
+            else {
+                writer.value(column[i]);
+            }
+        }
+    }
+
+    int outputCount = definition->outputSlots.size();
+    writer.u32(static_cast<uint32_t>(outputCount));
+    for (int slot = 0; slot < outputCount; slot++) {
+        const string* column = outputs.data() + static_cast<size_t>(slot) * capacity;
+        for (int i = 0; i < count; i++) {
+            writer.text(column[i]);
+        }
+    }
+    return data;
+}
+
+bool InstancePool::restoreSnapshot(string_view data) {
+    SnapshotReader reader(data);
+    if (!reader.header(Snapshot::Kind::Pool, *definition)) {
+        return false;
+    }
+
+    // Columns are built aside and swapped in once everything was read
+    int newCount = static_cast<int>(reader.u32());
+    if (!reader.ok() || newCount < 0 || static_cast<size_t>(newCount) * 4 * sizeof(int) > data.size()) {
+        cout << "Snapshot is damaged" << endl;
+        return false;
+    }
+    int newCapacity = max(newCount, 16);
+
+    vector<int> newStates(newCount);
+    vector<int> newPendingStates(newCount);
+    vector<int> newPendingInputs(newCount);
+    vector<int> remaining(newCount);
+    reader.i32s(newStates.data(), newCount);
+    reader.i32s(newPendingStates.data(), newCount);
+    reader.i32s(newPendingInputs.data(), newCount);
+    reader.i32s(remaining.data(), newCount);
+
+    int stateCount = static_cast<int>(definition->states.size());
+    int inputCount = definition->inputSlots.size();
+    for (int i = 0; i < newCount; i++) {
+        if (newStates[i] < -1 || newStates[i] >= stateCount || newPendingStates[i] < -1 || newPendingStates[i] >= stateCount
+            || newPendingInputs[i] < -1 || newPendingInputs[i] >= inputCount) {
+            cout << "Snapshot is damaged" << endl;
+            return false;
+        }
+    }
+
+    Clock::TimePoint now = clock->now();
+    vector<Clock::TimePoint> newPendingDue(newCount);
+    vector<string> newPendingValues(newCount);
+    for (int i = 0; i < newCount && reader.ok(); i++) {
+        if (newPendingStates[i] != -1) {
+            newPendingDue[i] = now + chrono::milliseconds(remaining[i]);
+            reader.text(newPendingValues[i]);
+        }
+    }
+
+    vector<chrono::steady_clock::time_point> newEnteredAt(newCount);
+    for (int i = 0; i < newCount; i++) {
+        chrono::microseconds elapsed(static_cast<int64_t>(reader.u64()));
+        newEnteredAt[i] = now - chrono::duration_cast<Clock::TimePoint::duration>(elapsed);
+    }
+
+    int variableCount = static_cast<int>(definition->variables.size());
+    if (reader.u32() != static_cast<uint32_t>(variableCount)) {
+        cout << "Snapshot is damaged" << endl;
+        return false;
+    }
+    vector<Value> newVariables(static_cast<size_t>(variableCount) * newCapacity);
+    for (int slot = 0; slot < variableCount && reader.ok(); slot++) {
+        Value* column = newVariables.data() + static_cast<size_t>(slot) * newCapacity;
+        uint8_t type = reader.u8();
+        if (type != mixedColumn && type > static_cast<uint8_t>(ValueType::String)) {
+            cout << "Snapshot is damaged" << endl;
+            return false;
+        }
+        for (int i = 0; i < newCount; i++) {
+            if (type == mixedColumn) {
+                reader.value(column[i]);
+            }
+            else {
+                reader.valuePayload(static_cast<ValueType>(type), column[i]);
+            }
+        }
+    }
+
+    int outputCount = definition->outputSlots.size();
+    if (reader.u32() != static_cast<uint32_t>(outputCount)) {
+        cout << "Snapshot is damaged" << endl;
+        return false;
+    }
+    vector<string> newOutputs(static_cast<size_t>(outputCount) * newCapacity);
+    for (int slot = 0; slot < outputCount && reader.ok(); slot++) {
+        string* column = newOutputs.data() + static_cast<size_t>(slot) * newCapacity;
+        for (int i = 0; i < newCount; i++) {
+            reader.text(column[i]);
+        }
+    }
+
+    if (!reader.ok()) {
+        cout << "Snapshot is damaged" << endl;
+        return false;
+    }
+
+    count = newCount;
+    capacity = newCapacity;
+    states = move(newStates);
+    pendingStates = move(newPendingStates);
+    pendingDue = move(newPendingDue);
+    pendingInputs = move(newPendingInputs);
+    pendingValues = move(newPendingValues);
+    enteredAt = move(newEnteredAt);
+    variables = move(newVariables);
+    outputs = move(newOutputs);
+    states.reserve(capacity);
+    pendingStates.reserve(capacity);
+    pendingDue.reserve(capacity);
+    pendingInputs.reserve(capacity);
+    pendingValues.reserve(capacity);
+    enteredAt.reserve(capacity);
+    return true;
+}
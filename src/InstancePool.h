@@ -0,0 +1,244 @@
+/**
+ * @file InstancePool.h
+ * @brief Header file for the InstancePool class, many instances of one automaton in column storage
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#ifndef INSTANCEPOOL_H
+#define INSTANCEPOOL_H
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Clock.h"
+#include "InstanceView.h"
+#include "MachineDefinition.h"
+#include "Snapshot.h"
+#include "Value.h"
+
+/**
+ * @class InstancePool
+ * @brief Runs many instances of one MachineDefinition, runtime data is stored as struct of arrays
+ *
+ * Every field has its own column, variables and outputs have one column per slot,
+ * so stepping all instances walks memory linearly. Value of variable slot s of instance i
+ * is variables[s * capacity + i]. Delays are not waited for, delayed transitions are
+ * remembered with the time they are due and fired by completeDue() or completePending().
+ * Delay-only transitions of a state start when the state is entered, as in MooreMachine.
+ *
+ * Cells are not typed, every variable is a full Value and every output a std::string,
+ * so the VM reads pool instances through the same InstanceView as MachineInstance.
+ * On 64-bit libstdc++ one instance takes 60 bytes of fixed columns, 72 bytes per
+ * variable and 32 bytes per output, strings longer than 15 characters allocate on
+ * top of that. Columns grow by doubling, so up to twice that is reserved.
+ */
+class InstancePool {
+private:
+    // Automaton run by all instances
+    std::shared_ptr<const MachineDefinition> definition;
+
+    // Time source of all instances
+    std::shared_ptr<Clock> clock;
+
+    // Number of instances
+    int count = 0;
+
+    // Number of instances the columns have room for
+    int capacity = 0;
+
+    // Index of the current state of each instance
+    std::vector<int> states;
+
+    // Target of the delayed transition waiting to fire, -1 if there is none
+    std::vector<int> pendingStates;
+
+    // Time the waiting transition is due, taken from clock
+    std::vector<Clock::TimePoint> pendingDue;
+
+    // Input that took the waiting transition, -1 for delay-only transitions
+    std::vector<int> pendingInputs;
+
+    // Value of that input, its action sees it once the delay passes
+    std::vector<std::string> pendingValues;
+
+    // Time when the current state was entered
+    std::vector<std::chrono::steady_clock::time_point> enteredAt;
+
+    // Variable columns, one per variable slot
+    std::vector<Value> variables;
+
+    // Output columns, one per output slot
+    std::vector<std::string> outputs;
+
+    /**
+     * @brief Doubles the capacity and moves columns to the new layout
+     */
+    void grow();
+
+    /**
+     * @brief Takes the transition, enters the target or remembers it if the transition is delayed
+     * @param id Id of the instance
+     * @param transition Transition selected for the event
+     * @param executor Executor of the current event, bound to the instance
+     * @param inputId Id of the input of the event
+     * @param inputValue Value of the input
+     */
+    void take(int id, const CompiledTransition& transition, CodeExecutor& executor, int inputId, const std::string& inputValue);
+
+    /**
+     * @brief Starts delay-only transition of the state the instance entered
+     * @param id Id of the instance
+     */
+    void entered(int id);
+
+public:
+    /**
+     * @brief Creates empty pool
+     * @param definition Automaton run by all instances
+     * @param clock Time source of all instances
+     */
+    explicit InstancePool(std::shared_ptr<const MachineDefinition> definition, std::shared_ptr<Clock> clock = Clock::real());
+
+    /**
+     * @brief Adds instance in the start state with initial values of the variables
+     * @return Id of the instance
+     */
+    int add();
+
+    /**
+     * @brief Gets number of instances
+     */
+    int size() const {
+        return count;
+    }
+
+    /**
+     * @brief Gets view the VM uses to access the instance, valid until the next add()
+     * @param id Id of the instance
+     */
+    InstanceView view(int id);
+
+    /**
+     * @brief Executes action of the current state of the instance
+     * @param id Id of the instance
+     */
+    void start(int id);
+
+    /**
+     * @brief Executes action of the current state of all instances
+     */
+    void startAll();
+
+    /**
+     * @brief Processes input event by one instance
+     * @param id Id of the instance
+     * @param inputName Name of the input
+     * @param inputValue Value of the input
+     * @return true if a transition was taken
+     */
+    bool processInput(int id, const std::string& inputName, const std::string& inputValue);
+
+    /**
+     * @brief Processes input event by all instances
+     *
+     * Guards that read neither variables nor elapsed() give the same result for every
+     * instance, they are evaluated once per call.
+     *
+     * @param inputName Name of the input
+     * @param inputValue Value of the input
+     * @return Number of instances that took a transition
+     */
+    int processInput(const std::string& inputName, const std::string& inputValue);
+
+    /**
+     * @brief Gets time left until the waiting transition is due
+     * @param id Id of the instance
+     * @return Milliseconds left, 0 if it is due already, -1 if no delayed transition waits
+     */
+    int getPendingDelay(int id) const;
+
+    /**
+     * @brief Gets time the waiting transition is due
+     * @param id Id of the instance
+     * @return Due time, TimePoint::max() if no delayed transition waits
+     */
+    Clock::TimePoint getPendingDue(int id) const {
+        return pendingStates[id] == -1 ? Clock::TimePoint::max() : pendingDue[id];
+    }
+
+    /**
+     * @brief Fires delayed transitions of all instances that are due
+     * @return Number of transitions fired
+     */
+    int completeDue();
+
+    /**
+     * @brief Gets earliest time completeDue() has something to fire
+     * @return Time, TimePoint::max() if no delayed transition waits
+     */
+    Clock::TimePoint nextDue() const;
+
+    /**
+     * @brief Fires the waiting delayed transition and enters its target, even if it is not due yet
+     * @param id Id of the instance
+     */
+    void completePending(int id);
+
+    /**
+     * @brief Drops the waiting delayed transition
+     * @param id Id of the instance
+     */
+    void cancelPending(int id);
+
+    /**
+     * @brief Gets index of the current state of the instance
+     */
+    int getCurrentState(int id) const {
+        return states[id];
+    }
+
+    /**
+     * @brief Gets value of the variable of the instance
+     * @param id Id of the instance
+     * @param slot Slot of the variable
+     */
+    const Value& getVariable(int id, int slot) const {
+        return variables[slot * capacity + id];
+    }
+
+    /**
+     * @brief Gets value of the output of the instance
+     * @param id Id of the instance
+     * @param slot Slot of the output
+     */
+    const std::string& getOutput(int id, int slot) const {
+        return outputs[slot * capacity + id];
+    }
+
+    /**
+     * @brief Gets output of the instance as name:value pairs
+     * @param id Id of the instance
+     */
+    std::string getCurrentOutput(int id) const;
+
+    /**
+     * @brief Creates binary snapshot of all instances, waiting delayed transitions included
+     *
+     * Columns are written one after another like they are stored, so saving and
+     * restoring mostly copies whole columns.
+     *
+     * @return Snapshot, restorable into a pool of the same definition
+     */
+    std::string saveSnapshot() const;
+
+    /**
+     * @brief Replaces all instances with the ones saved by saveSnapshot()
+     * @param data Snapshot
+     * @return false if the snapshot does not fit the definition, the pool is left untouched then
+     */
+    bool restoreSnapshot(std::string_view data);
+};
+
+#endif // INSTANCEPOOL_H
@@ -0,0 +1,78 @@
+/**
+ * @file InstanceView.cpp
+ * @brief Implementation of the InstanceView struct
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#include <iostream>
+#include "CodeExecutor.h"
+#include "InstanceView.h"
+
+using namespace std;
+
+void InstanceView::resetOutputs() const {
+    for (int slot = 0; slot < definition->outputSlots.size(); slot++) {
+        output(slot).clear();
+    }
+}
+
+void InstanceView::setCurrentState(int state) const {
+    *currentState = state;
+    *enteredAt = clock->now();
+}
+
+void InstanceView::enterState(int state, CodeExecutor& executor) const {
+    setCurrentState(state);
+    const State& target = definition->states[state];
+    if (target.constantAction) {
+        // Outputs were reset before, row holds empty strings for outputs the action does not write
+        for (size_t slot = 0; slot < target.outputRow.size(); slot++) {
+            output(slot).assign(target.outputRow[slot]);
+        }
+        return;
+    }
+    executor.executeStateExpr(target.action.program);
+}
+
+int InstanceView::getDelayValue(const CompiledTransition& transition) const {
+    // Delay given as number
+    if (transition.delayMs != -1) {
+        return transition.delayMs;
+    }
+
+    // Delay given as variable, it has to hold a number
+    if (transition.delaySlot != -1) {
+        const Value& value = variable(transition.delaySlot);
+        if (value.isNumeric()) {
+            return value.asInt();
+        }
+        cout << "Value of the variable \"" << definition->variables[transition.delaySlot].name << "\" for delay is not a number" << endl;
+    }
+    return -1;
+}
+
+int InstanceView::getEntryDelay(int& nextState) const {
+    int state = *currentState;
+    if (state == -1) {
+        return -1;
+    }
+
+    // Shortest delay wins, the first one in the table on a tie
+    int entryDelay = -1;
+    auto [first, last] = definition->transitionRun(state, definition->inputSlots.find(""));
+    for (int i = first; i < last; i++) {
+        const CompiledTransition& transition = definition->states[state].compiled[i];
+        if (!transition.hasGuard && transition.hasDelay) {
+            int delay = getDelayValue(transition);
+            if (delay != -1 && (entryDelay == -1 || delay < entryDelay)) {
+                entryDelay = delay;
+                nextState = transition.nextState;
+            }
+        }
+    }
+    return entryDelay;
+}
+
+int InstanceView::getElapsed() const {
+    return static_cast<int>(chrono::duration_cast<chrono::milliseconds>(clock->now() - *enteredAt).count());
+}
@@ -0,0 +1,95 @@
+/**
+ * @file InstanceView.h
+ * @brief Header file for the InstanceView struct, access to runtime data of one instance
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#ifndef INSTANCEVIEW_H
+#define INSTANCEVIEW_H
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include "Clock.h"
+#include "MachineDefinition.h"
+#include "Value.h"
+
+class CodeExecutor;
+
+/**
+ * @struct InstanceView
+ * @brief Pointers to runtime data of one instance, wherever it is stored
+ *
+ * MachineInstance keeps its variables and outputs in own vectors (stride 1),
+ * InstancePool keeps them in columns shared by all instances (stride is the pool capacity).
+ * The VM reads and writes instances only through this view.
+ */
+struct InstanceView {
+    const MachineDefinition* definition = nullptr; // Automaton being run
+    int* currentState = nullptr; // Index of the current state
+    Value* variables = nullptr; // Variable in slot 0
+    size_t variableStride = 1; // Distance between variables of neighbouring slots
+    std::string* outputs = nullptr; // Output in slot 0
+    size_t outputStride = 1; // Distance between outputs of neighbouring slots
+    std::chrono::steady_clock::time_point* enteredAt = nullptr; // Time when the current state was entered
+    const Clock* clock = nullptr; // Time source of the instance
+    unsigned long* variablesVersion = nullptr; // Incremented on variable writes, nullptr if nobody caches guards
+
+    Value& variable(int slot) const {
+        return variables[slot * variableStride];
+    }
+
+    std::string& output(int slot) const {
+        return outputs[slot * outputStride];
+    }
+
+    /**
+     * @brief Marks variables as changed
+     */
+    void variablesChanged() const {
+        if (variablesVersion) {
+            (*variablesVersion)++;
+        }
+    }
+
+    /**
+     * @brief Sets all outputs to empty string
+     */
+    void resetOutputs() const;
+
+    /**
+     * @brief Moves to the state without executing its action
+     * @param state Index of the state
+     */
+    void setCurrentState(int state) const;
+
+    /**
+     * @brief Moves to the state and executes its action, constant actions are copied from the cached row
+     * @param state Index of the state
+     * @param executor Executor of the current event, bound to this view
+     */
+    void enterState(int state, CodeExecutor& executor) const;
+
+    /**
+     * @brief Gets delay of the transition, given as number or as name of a variable holding one
+     * @param transition Compiled transition
+     * @return Delay in milliseconds, -1 if transition has no valid delay
+     */
+    int getDelayValue(const CompiledTransition& transition) const;
+
+    /**
+     * @brief Finds delay-only transition of the current state that fires first, all engines start it when the state is entered
+     * @param nextState Receives target of the transition
+     * @return Delay in milliseconds, -1 if the state has no delay-only transition with a valid delay
+     */
+    int getEntryDelay(int& nextState) const;
+
+    /**
+     * @brief Gets time spent in the current state
+     * @return Milliseconds since the current state was entered
+     */
+    int getElapsed() const;
+};
+
+#endif // INSTANCEVIEW_H
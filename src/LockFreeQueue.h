@@ -0,0 +1,264 @@
+/**
+ * @file LockFreeQueue.h
+ * @brief Lock-free queues used to pass events and work between threads
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#ifndef LOCKFREEQUEUE_H
+#define LOCKFREEQUEUE_H
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+/**
+ * @class MpscQueue
+ * @brief Unbounded FIFO queue, any number of threads push, one thread at a time pops
+ *
+ * Linked list with a dummy node (Vyukov). Push is one atomic exchange, pop does not
+ * use atomic read-modify-write at all. A pop may miss an element whose push is still
+ * in progress, the caller has to track the number of elements if it needs to retry.
+ */
+template <typename T>
+class MpscQueue {
+private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        T value;
+
+        Node() = default;
+        explicit Node(T value) : value(std::move(value)) {}
+    };
+
+    // Most recently pushed node, producers swap it
+    std::atomic<Node*> head;
+
+    // Dummy node in front of the oldest element, used only by the consumer
+    Node* tail;
+
+public:
+    MpscQueue() {
+        Node* stub = new Node();
+        head.store(stub, std::memory_order_relaxed);
+        tail = stub;
+    }
+
+    ~MpscQueue() {
+        while (tail) {
+            Node* next = tail->next.load(std::memory_order_relaxed);
+            delete tail;
+            tail = next;
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    /**
+     * @brief Appends value, safe to call from any thread
+     * @param value Value to append
+     */
+    void push(T value) {
+        Node* node = new Node(std::move(value));
+        Node* previous = head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    /**
+     * @brief Removes the oldest value, only the consumer may call it
+     * @param value Receives the removed value
+     * @return false if there is nothing to remove
+     */
+    bool pop(T& value) {
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (!next) {
+            return false;
+        }
+        value = std::move(next->value);
+        delete tail;
+        tail = next;
+        return true;
+    }
+};
+
+/**
+ * @class BoundedQueue
+ * @brief Fixed size FIFO queue any number of threads push to and pop from
+ *
+ * Ring of cells with sequence numbers (Vyukov), push and pop claim a cell with one
+ * compare-exchange and never block each other. Cells are allocated once, values
+ * are moved in and out of them, so a queue of strings reuses their buffers.
+ */
+template <typename T>
+class BoundedQueue {
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    // Cells of the ring, the size is a power of two
+    std::unique_ptr<Cell[]> cells;
+
+    // Size of the ring minus one
+    size_t mask;
+
+    // Position of the next push, on its own cache line
+    alignas(64) std::atomic<size_t> pushPos{0};
+
+    // Position of the next pop, on its own cache line
+    alignas(64) std::atomic<size_t> popPos{0};
+
+    /**
+     * @brief Claims cell for push
+     * @return Claimed cell, nullptr if the queue is full
+     */
+    Cell* claimPush(size_t& pos) {
+        pos = pushPos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells[pos & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            long difference = static_cast<long>(sequence) - static_cast<long>(pos);
+            if (difference == 0) {
+                if (pushPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    return &cell;
+                }
+            }
+            else if (difference < 0) {
+                return nullptr;
+            }
+            else {
+                pos = pushPos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+public:
+    /**
+     * @brief Creates queue
+     * @param capacity Maximum number of elements, rounded up to a power of two
+     */
+    explicit BoundedQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        cells.reset(new Cell[size]);
+        mask = size - 1;
+        for (size_t i = 0; i < size; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    /**
+     * @brief Appends value
+     * @param value Value to append, left untouched if the queue is full
+     * @return false if the queue is full
+     */
+    bool push(T&& value) {
+        size_t pos;
+        Cell* cell = claimPush(pos);
+        if (!cell) {
+            return false;
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Appends value
+     * @param value Value to append
+     * @return false if the queue is full
+     */
+    bool push(const T& value) {
+        size_t pos;
+        Cell* cell = claimPush(pos);
+        if (!cell) {
+            return false;
+        }
+        cell->value = value;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Removes the oldest value
+     * @param value Receives the removed value
+     * @return false if the queue is empty
+     */
+    bool pop(T& value) {
+        size_t pos = popPos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells[pos & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            long difference = static_cast<long>(sequence) - static_cast<long>(pos + 1);
+            if (difference == 0) {
+                if (popPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = std::move(cell.value);
+                    cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0) {
+                return false;
+            }
+            else {
+                pos = popPos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Removes up to count oldest values, all of them claimed at once
+     * @param values Receives the removed values, room for count of them
+     * @param count Maximum number of values to remove
+     * @return Number of values removed, 0 if the queue is empty
+     */
+    size_t pop(T* values, size_t count) {
+        size_t pos = popPos.load(std::memory_order_relaxed);
+        for (;;) {
+            // Ready cells in a row starting at pos, a push in progress ends the run
+            size_t ready = 0;
+            while (ready < count) {
+                size_t sequence = cells[(pos + ready) & mask].sequence.load(std::memory_order_acquire);
+                if (sequence != pos + ready + 1) {
+                    break;
+                }
+                ready++;
+            }
+
+            if (ready == 0) {
+                size_t sequence = cells[pos & mask].sequence.load(std::memory_order_acquire);
+                if (static_cast<long>(sequence) - static_cast<long>(pos + 1) < 0) {
+                    return 0;
+                }
+                pos = popPos.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            if (popPos.compare_exchange_weak(pos, pos + ready, std::memory_order_relaxed)) {
+                for (size_t i = 0; i < ready; i++) {
+                    Cell& cell = cells[(pos + i) & mask];
+                    values[i] = std::move(cell.value);
+                    cell.sequence.store(pos + i + mask + 1, std::memory_order_release);
+                }
+                return ready;
+            }
+        }
+    }
+
+    /**
+     * @brief Checks if every claimed push was popped, a push still in progress counts as an element
+     */
+    bool empty() const {
+        return pushPos.load(std::memory_order_relaxed) == popPos.load(std::memory_order_relaxed);
+    }
+};
+
+#endif // LOCKFREEQUEUE_H
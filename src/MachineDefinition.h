@@ -0,0 +1,80 @@
+/**
+ * @file MachineDefinition.h
+ * @brief Immutable compiled automaton shared by all its running instances
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#ifndef MACHINEDEFINITION_H
+#define MACHINEDEFINITION_H
+#pragma once
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Structs.h"
+#include "SymbolTable.h"
+
+/**
+ * @struct MachineDefinition
+ * @brief States, transitions and declarations of the machine, never modified once built
+ *
+ * Built by MooreMachine::getDefinition() and held through std::shared_ptr<const MachineDefinition>,
+ * so any number of MachineInstance objects run one automaton without copying it.
+ */
+struct MachineDefinition {
+    std::vector<State> states; // Compiled states
+    std::vector<Variable> variables; // Declared variables with their initial values, index is the slot
+    std::vector<std::string> inputs; // Inputs of the machine
+    std::vector<std::string> outputs; // Outputs of the machine
+    SymbolTable variableSlots; // Variable names to slots
+    SymbolTable inputSlots; // Input names to ids of the transition tables
+    SymbolTable outputSlots; // Output names to indices in the output row
+    int startState = -1; // Index of the start state
+    int transitionCount = 0; // Number of compiled transitions, CompiledTransition::id is below it
+
+    /**
+     * @brief Gets range of the transitions of one input in the state's table
+     * @param state Index of the state
+     * @param inputId Id of the input, -1 if the input is unknown
+     * @return Indices [first, last) into states[state].compiled
+     */
+    std::pair<int, int> transitionRun(int state, int inputId) const {
+        const std::vector<int>& runs = states[state].inputRuns;
+        // Input interned after the state was compiled has no transitions in it
+        if (inputId < 0 || inputId + 1 >= static_cast<int>(runs.size())) {
+            return {0, 0};
+        }
+        return {runs[inputId], runs[inputId + 1]};
+    }
+
+    /**
+     * @brief Finds first transition of the state the input takes
+     * @param state Index of the state
+     * @param inputId Id of the input, -1 if the input is unknown
+     * @param guardHolds Called with a transition whose guard has to be evaluated, returns its result
+     * @return Taken transition, nullptr if there is none, delay-only transitions are never returned
+     */
+    template <typename GuardFn>
+    const CompiledTransition* selectTransition(int state, int inputId, GuardFn&& guardHolds) const {
+        auto [first, last] = transitionRun(state, inputId);
+        for (int i = first; i < last; i++) {
+            const CompiledTransition& transition = states[state].compiled[i];
+
+            // BoolExpr in [] has to be fulfilled
+            if (transition.hasGuard) {
+                if (guardHolds(transition)) {
+                    return &transition;
+                }
+            }
+
+            // Transition by input only
+            else if (transition.hasInput) {
+                return &transition;
+            }
+        }
+        return nullptr;
+    }
+};
+
+#endif // MACHINEDEFINITION_H
@@ -0,0 +1,457 @@
+/**
+ * @file MachineImage.cpp
+ * @brief Implementation of the MachineImage and MachineImageBuilder classes
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include "MachineImage.h"
+#include "MooreMachine.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MACHINE_IMAGE_MMAP
+#endif
+
+using namespace std;
+
+// Records are used in place, so the file has to match the host layout
+static bool hostIsLittleEndian() {
+    uint32_t probe = 1;
+    char first;
+    memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+// Size of one record of every section, in Section order
+static const size_t recordSizes[ImageFormat::SectionCount] = {
+    1,
+    sizeof(ImageFormat::StringRecord),
+    sizeof(uint32_t),
+    sizeof(ImageFormat::ValueRecord),
+    sizeof(ImageFormat::InstructionRecord),
+    sizeof(ImageFormat::ProgramRecord),
+    sizeof(ImageFormat::VariableRecord),
+    sizeof(ImageFormat::TransitionRecord),
+    sizeof(ImageFormat::StateRecord),
+};
+
+MachineImage::~MachineImage() {
+    close();
+}
+
+void MachineImage::close() {
+#ifdef MACHINE_IMAGE_MMAP
+    if (mapped) {
+        munmap(const_cast<char*>(data), size);
+    }
+#endif
+    mapped = false;
+    data = nullptr;
+    size = 0;
+    buffer.clear();
+}
+
+bool MachineImage::open(const string& filename) {
+    close();
+    if (!hostIsLittleEndian()) {
+        cout << "Machine images are supported only on little endian hosts" << endl;
+        return false;
+    }
+
+#ifdef MACHINE_IMAGE_MMAP
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+        cout << "Failed to open file: " << filename << endl;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        void* address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address != MAP_FAILED) {
+            data = static_cast<const char*>(address);
+            size = static_cast<size_t>(info.st_size);
+            mapped = true;
+        }
+    }
+    ::close(fd);
+#else
+    ifstream file(filename, ios::binary);
+    if (!file.is_open()) {
+        cout << "Failed to open file: " << filename << endl;
+        return false;
+    }
+    buffer.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    data = buffer.data();
+    size = buffer.size();
+#endif
+
+    if (!data || size < sizeof(ImageFormat::Header)) {
+        cout << "File is not a machine image: " << filename << endl;
+        close();
+        return false;
+    }
+
+    const ImageFormat::Header& head = header();
+    if (head.magic != ImageFormat::magic) {
+        cout << "File is not a machine image: " << filename << endl;
+        close();
+        return false;
+    }
+    if (head.version != ImageFormat::version || head.fileSize != size) {
+        cout << "Machine image " << filename << " was written by a different version" << endl;
+        close();
+        return false;
+    }
+
+    // Sections have to lie inside the file and be aligned for their records
+    for (uint32_t section = 0; section < ImageFormat::SectionCount; section++) {
+        uint64_t offset = head.sectionOffsets[section];
+        uint64_t bytes = static_cast<uint64_t>(head.sectionCounts[section]) * recordSizes[section];
+        if (offset % 8 != 0 || offset > size || bytes > size - offset) {
+            cout << "Machine image " << filename << " is damaged" << endl;
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+string_view MachineImage::text(uint32_t id) const {
+    if (id >= count(ImageFormat::Strings)) {
+        return {};
+    }
+    const ImageFormat::StringRecord& record = records<ImageFormat::StringRecord>(ImageFormat::Strings)[id];
+    uint32_t chars = count(ImageFormat::Chars);
+    if (record.offset > chars || record.size > chars - record.offset) {
+        return {};
+    }
+    return string_view(records<char>(ImageFormat::Chars) + record.offset, record.size);
+}
+
+Value MachineImage::value(const ImageFormat::ValueRecord& record) const {
+    switch (static_cast<ValueType>(record.type)) {
+        case ValueType::Int:
+            return static_cast<int>(record.bits);
+        case ValueType::Double: {
+            double number;
+            memcpy(&number, &record.bits, sizeof(number));
+            return number;
+        }
+        case ValueType::Bool:
+            return record.bits != 0;
+        case ValueType::Char:
+            return static_cast<char>(record.bits);
+        case ValueType::String:
+            return string(text(record.text));
+    }
+    return Value();
+}
+
+// Values left on the stack after every instruction have to be known and never go below zero,
+// jumps only go forward, so one pass over the code sees every path into an instruction
+static bool checkStackDepth(const vector<Instruction>& code, int result) {
+    vector<int> depthAt(code.size(), -1);
+    int depth = 0;
+    bool reachable = true;
+    for (size_t i = 0; i < code.size(); i++) {
+        if (depthAt[i] != -1) {
+            if (reachable && depth != depthAt[i]) {
+                return false;
+            }
+            depth = depthAt[i];
+            reachable = true;
+        }
+        if (!reachable) {
+            return false;
+        }
+
+        const Instruction& instruction = code[i];
+        int pops = 0;
+        int pushes = 0;
+        switch (instruction.op) {
+            case OpCode::PushInt:
+            case OpCode::PushBool:
+            case OpCode::PushString:
+            case OpCode::PushConst:
+            case OpCode::LoadVar:
+            case OpCode::Defined:
+            case OpCode::ValueOf:
+            case OpCode::Elapsed:
+            case OpCode::InputEqInt:
+            case OpCode::InputNeInt:
+            case OpCode::InputLtInt:
+            case OpCode::InputLeInt:
+            case OpCode::InputGtInt:
+            case OpCode::InputGeInt:
+                pushes = 1;
+                break;
+            case OpCode::StoreVar:
+            case OpCode::Output:
+            case OpCode::Pop:
+            case OpCode::JumpIfFalse:
+                pops = 1;
+                break;
+            case OpCode::Atoi:
+            case OpCode::Neg:
+            case OpCode::Not:
+            case OpCode::ToBool:
+                pops = 1;
+                pushes = 1;
+                break;
+            case OpCode::Add:
+            case OpCode::Sub:
+            case OpCode::Mul:
+            case OpCode::Div:
+            case OpCode::Mod:
+            case OpCode::Eq:
+            case OpCode::Ne:
+            case OpCode::Lt:
+            case OpCode::Le:
+            case OpCode::Gt:
+            case OpCode::Ge:
+                pops = 2;
+                pushes = 1;
+                break;
+            case OpCode::Jump:
+            case OpCode::Halt:
+                break;
+        }
+        if (depth < pops) {
+            return false;
+        }
+        depth += pushes - pops;
+
+        if (instruction.op == OpCode::Jump || instruction.op == OpCode::JumpIfFalse) {
+            size_t target = static_cast<size_t>(instruction.arg);
+            if (target <= i || (depthAt[target] != -1 && depthAt[target] != depth)) {
+                return false;
+            }
+            depthAt[target] = depth;
+            reachable = instruction.op == OpCode::JumpIfFalse;
+        }
+        else if (instruction.op == OpCode::Halt) {
+            if (depth != result) {
+                return false;
+            }
+            reachable = false;
+        }
+    }
+    return true;
+}
+
+bool MachineImage::program(uint32_t index, Program& program, int result) const {
+    if (index >= count(ImageFormat::Programs)) {
+        return false;
+    }
+    const ImageFormat::ProgramRecord& record = records<ImageFormat::ProgramRecord>(ImageFormat::Programs)[index];
+    if (!contains(ImageFormat::Instructions, record.code) || !contains(ImageFormat::Ids, record.strings)
+        || !contains(ImageFormat::Values, record.constants)) {
+        return false;
+    }
+
+    // Instructions are copied as they are, only opcodes are checked
+    const ImageFormat::InstructionRecord* code = records<ImageFormat::InstructionRecord>(ImageFormat::Instructions) + record.code.first;
+    program.code.resize(record.code.count);
+    for (uint32_t i = 0; i < record.code.count; i++) {
+        if (code[i].op > static_cast<uint8_t>(OpCode::Halt)) {
+            return false;
+        }
+        program.code[i] = {static_cast<OpCode>(code[i].op), code[i].arg, code[i].arg2};
+    }
+    if (!program.code.empty() && program.code.back().op != OpCode::Halt) {
+        return false;
+    }
+
+    const uint32_t* strings = records<uint32_t>(ImageFormat::Ids) + record.strings.first;
+    program.strings.resize(record.strings.count);
+    for (uint32_t i = 0; i < record.strings.count; i++) {
+        program.strings[i] = text(strings[i]);
+    }
+
+    const ImageFormat::ValueRecord* constants = records<ImageFormat::ValueRecord>(ImageFormat::Values) + record.constants.first;
+    program.constants.resize(record.constants.count);
+    for (uint32_t i = 0; i < record.constants.count; i++) {
+        program.constants[i] = value(constants[i]);
+    }
+
+    // Operands index the tables, a damaged one must not reach the VM
+    for (const Instruction& instruction : program.code) {
+        switch (instruction.op) {
+            case OpCode::PushString:
+            case OpCode::Defined:
+            case OpCode::ValueOf:
+            case OpCode::InputEqInt:
+            case OpCode::InputNeInt:
+            case OpCode::InputLtInt:
+            case OpCode::InputLeInt:
+            case OpCode::InputGtInt:
+            case OpCode::InputGeInt:
+                if (instruction.arg < 0 || instruction.arg >= static_cast<int>(program.strings.size())) {
+                    return false;
+                }
+                break;
+            case OpCode::PushConst:
+                if (instruction.arg < 0 || instruction.arg >= static_cast<int>(program.constants.size())) {
+                    return false;
+                }
+                break;
+            case OpCode::Jump:
+            case OpCode::JumpIfFalse:
+                if (instruction.arg < 0 || instruction.arg >= static_cast<int>(program.code.size())) {
+                    return false;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    if (!checkStackDepth(program.code, result)) {
+        return false;
+    }
+
+    program.valid = record.flags & ImageFormat::ProgramValid;
+    program.readsVariables = record.flags & ImageFormat::ProgramReadsVariables;
+    program.readsTime = record.flags & ImageFormat::ProgramReadsTime;
+    return true;
+}
+
+bool MachineImage::convert(const string& jsonFile, const string& imageFile) {
+    MooreMachine machine;
+    machine.loadFromJSONFile(jsonFile);
+    if (machine.getStates().empty()) {
+        cout << "Machine " << jsonFile << " has no states" << endl;
+        return false;
+    }
+    return machine.saveImage(imageFile);
+}
+
+uint32_t MachineImageBuilder::addString(string_view text) {
+    auto it = stringIds.find(string(text));
+    if (it != stringIds.end()) {
+        return it->second;
+    }
+
+    uint32_t id = static_cast<uint32_t>(strings.size());
+    strings.push_back({static_cast<uint32_t>(chars.size()), static_cast<uint32_t>(text.size())});
+    chars.append(text.data(), text.size());
+    stringIds.emplace(string(text), id);
+    return id;
+}
+
+ImageFormat::Range MachineImageBuilder::addStrings(const vector<string>& texts) {
+    ImageFormat::Range range{static_cast<uint32_t>(ids.size()), static_cast<uint32_t>(texts.size())};
+    for (const auto& text : texts) {
+        uint32_t id = addString(text);
+        ids.push_back(id);
+    }
+    return range;
+}
+
+ImageFormat::Range MachineImageBuilder::addIds(const vector<int>& list) {
+    ImageFormat::Range range{static_cast<uint32_t>(ids.size()), static_cast<uint32_t>(list.size())};
+    for (int id : list) {
+        ids.push_back(static_cast<uint32_t>(id));
+    }
+    return range;
+}
+
+ImageFormat::ValueRecord MachineImageBuilder::valueRecord(const Value& value) {
+    ImageFormat::ValueRecord record{static_cast<uint32_t>(value.getType()), 0, 0};
+    switch (value.getType()) {
+        case ValueType::Double: {
+            double number = value.asDouble();
+            memcpy(&record.bits, &number, sizeof(number));
+            break;
+        }
+        case ValueType::String:
+            record.text = addString(value.asString());
+            break;
+        default:
+            record.bits = value.asInt();
+            break;
+    }
+    return record;
+}
+
+uint32_t MachineImageBuilder::addProgram(const Program& program) {
+    ImageFormat::ProgramRecord record{};
+    record.code = {static_cast<uint32_t>(instructions.size()), static_cast<uint32_t>(program.code.size())};
+    for (const Instruction& instruction : program.code) {
+        ImageFormat::InstructionRecord encoded{};
+        encoded.op = static_cast<uint8_t>(instruction.op);
+        encoded.arg = instruction.arg;
+        encoded.arg2 = instruction.arg2;
+        instructions.push_back(encoded);
+    }
+    record.strings = addStrings(program.strings);
+
+    // Constants may add strings, so the range starts after they were converted
+    vector<ImageFormat::ValueRecord> constants;
+    for (const Value& constant : program.constants) {
+        constants.push_back(valueRecord(constant));
+    }
+    record.constants = {static_cast<uint32_t>(values.size()), static_cast<uint32_t>(constants.size())};
+    values.insert(values.end(), constants.begin(), constants.end());
+
+    record.flags = (program.valid ? ImageFormat::ProgramValid : 0)
+        | (program.readsVariables ? ImageFormat::ProgramReadsVariables : 0)
+        | (program.readsTime ? ImageFormat::ProgramReadsTime : 0);
+    programs.push_back(record);
+    return static_cast<uint32_t>(programs.size() - 1);
+}
+
+bool MachineImageBuilder::write(const string& filename) {
+    if (!hostIsLittleEndian()) {
+        cout << "Machine images are supported only on little endian hosts" << endl;
+        return false;
+    }
+
+    // Bytes and record count of every section, in Section order
+    const pair<const char*, size_t> sections[ImageFormat::SectionCount] = {
+        {chars.data(), chars.size()},
+        {reinterpret_cast<const char*>(strings.data()), strings.size()},
+        {reinterpret_cast<const char*>(ids.data()), ids.size()},
+        {reinterpret_cast<const char*>(values.data()), values.size()},
+        {reinterpret_cast<const char*>(instructions.data()), instructions.size()},
+        {reinterpret_cast<const char*>(programs.data()), programs.size()},
+        {reinterpret_cast<const char*>(variables.data()), variables.size()},
+        {reinterpret_cast<const char*>(transitions.data()), transitions.size()},
+        {reinterpret_cast<const char*>(states.data()), states.size()},
+    };
+
+    // Every section starts at a multiple of 8, so records can be read in place
+    uint64_t offset = (sizeof(ImageFormat::Header) + 7) / 8 * 8;
+    for (uint32_t section = 0; section < ImageFormat::SectionCount; section++) {
+        header.sectionOffsets[section] = offset;
+        header.sectionCounts[section] = static_cast<uint32_t>(sections[section].second);
+        offset += (sections[section].second * recordSizes[section] + 7) / 8 * 8;
+    }
+    header.magic = ImageFormat::magic;
+    header.version = ImageFormat::version;
+    header.fileSize = offset;
+
+    string image(offset, '\0');
+    memcpy(&image[0], &header, sizeof(header));
+    for (uint32_t section = 0; section < ImageFormat::SectionCount; section++) {
+        if (sections[section].second > 0) {
+            memcpy(&image[header.sectionOffsets[section]], sections[section].first, sections[section].second * recordSizes[section]);
+        }
+    }
+
+    ofstream file(filename, ios::binary);
+    if (!file.is_open()) {
+        cout << "Failed to open file: " << filename << endl;
+        return false;
+    }
+    file.write(image.data(), static_cast<streamsize>(image.size()));
+    return static_cast<bool>(file);
+}
+
+#undef MACHINE_IMAGE_MMAP
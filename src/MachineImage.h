@@ -0,0 +1,348 @@
+/**
+ * @file MachineImage.h
+ * @brief Binary image of a compiled machine, mapped into memory and read in place
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#ifndef MACHINEIMAGE_H
+#define MACHINEIMAGE_H
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "Bytecode.h"
+#include "Value.h"
+
+/**
+ * @struct ImageFormat
+ * @brief Records of the image file
+ *
+ * File starts with a Header followed by sections, every section is an array of one
+ * record type. Records have fixed size and little endian fields, strings are ids
+ * into the Strings section whose records point into the Chars section. Lists of ids
+ * (inputs, program strings, input runs, ...) are ranges of the Ids section.
+ */
+struct ImageFormat {
+    // First four bytes of the file
+    static constexpr uint32_t magic = 0x4D494D4D; // "MMIM"
+
+    // Incremented whenever a record changes, older images are refused
+    static constexpr uint32_t version = 3;
+
+    /**
+     * @enum Section
+     * @brief Sections of the image in file order
+     */
+    enum Section : uint32_t {
+        Chars, // Bytes of all strings
+        Strings, // StringRecord
+        Ids, // uint32_t lists
+        Values, // ValueRecord
+        Instructions, // InstructionRecord
+        Programs, // ProgramRecord
+        Variables, // VariableRecord
+        Transitions, // TransitionRecord
+        States, // StateRecord
+        SectionCount
+    };
+
+    /**
+     * @struct Range
+     * @brief Consecutive records of a section
+     */
+    struct Range {
+        uint32_t first;
+        uint32_t count;
+    };
+
+    /**
+     * @struct Header
+     * @brief Start of the file
+     */
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t fileSize;
+        uint32_t name; // String id of the machine name
+        uint32_t description; // String id of the description
+        int32_t startState;
+        uint32_t reserved;
+        Range inputs; // Ids of declared inputs
+        Range outputs; // Ids of declared outputs
+        Range variableSlots; // Names of variable slots in slot order
+        Range inputSlots; // Names of input ids in id order
+        Range outputSlots; // Names of output slots in slot order
+        uint64_t sectionOffsets[SectionCount]; // Byte offset of every section
+        uint32_t sectionCounts[SectionCount]; // Number of records of every section
+    };
+
+    struct StringRecord {
+        uint32_t offset; // Offset in Chars
+        uint32_t size;
+    };
+
+    struct ValueRecord {
+        uint32_t type; // ValueType
+        uint32_t text; // String id of string values
+        int64_t bits; // int, bool and char value, bits of double
+    };
+
+    struct InstructionRecord {
+        uint8_t op; // OpCode
+        uint8_t reserved[3];
+        int32_t arg;
+        int32_t arg2;
+    };
+
+    struct ProgramRecord {
+        Range code; // InstructionRecords
+        Range strings; // Ids of string constants
+        Range constants; // ValueRecords
+        uint32_t flags; // ProgramValid, ProgramReadsVariables, ProgramReadsTime
+    };
+
+    static constexpr uint32_t ProgramValid = 1;
+    static constexpr uint32_t ProgramReadsVariables = 2;
+    static constexpr uint32_t ProgramReadsTime = 4;
+
+    struct VariableRecord {
+        uint32_t type; // String id of the declared type
+        uint32_t name; // String id of the name
+        ValueRecord value; // Initial value
+        uint32_t constant; // No action assigns the variable, it was folded into the code
+        uint32_t reserved;
+    };
+
+    struct TransitionRecord {
+        int32_t nextState;
+        uint32_t flags; // TransitionHasInput, TransitionHasGuard, TransitionHasDelay
+        int32_t delayMs;
+        int32_t delaySlot;
+        uint32_t guard; // Program index
+    };
+
+    static constexpr uint32_t TransitionHasInput = 1;
+    static constexpr uint32_t TransitionHasGuard = 2;
+    static constexpr uint32_t TransitionHasDelay = 4;
+
+    struct StateRecord {
+        uint32_t name; // String id
+        uint32_t outputExpr; // String id
+        uint32_t action; // Program index
+        uint32_t constantAction; // Action only writes constants, outputRow holds them
+        Range outputRow; // Ids of output values
+        Range transitions; // TransitionRecords in compiled order, statically false ones are left out
+        Range inputRuns; // Ids holding State::inputRuns
+        Range sources; // Ids of source transitions, inputEvent, boolExpr and delay string ids and next state for each
+    };
+};
+
+/**
+ * @class MachineImage
+ * @brief Read-only image file mapped into memory, records are used where they lie
+ *
+ * Opening checks only the header and section bounds, nothing is parsed. Ids stored
+ * in records are checked by the reader of the record.
+ *
+ * The machine does not run from the mapping. MooreMachine::loadFromImage() copies
+ * names, symbol tables and programs out of the records and closes the image, what
+ * loading saves is parsing JSON and compiling expressions, not the copies.
+ */
+class MachineImage {
+private:
+    // Start of the mapped file, nullptr if nothing is open
+    const char* data = nullptr;
+
+    // Size of the file
+    size_t size = 0;
+
+    // File read into memory where mapping is not available
+    std::string buffer;
+
+    // Mapping has to be released
+    bool mapped = false;
+
+    /**
+     * @brief Unmaps the file
+     */
+    void close();
+
+public:
+    MachineImage() = default;
+    ~MachineImage();
+
+    MachineImage(const MachineImage&) = delete;
+    MachineImage& operator=(const MachineImage&) = delete;
+
+    /**
+     * @brief Maps image file, prints the reason if it can not be used
+     * @param filename File to map
+     * @return true if the image is valid
+     */
+    bool open(const std::string& filename);
+
+    /**
+     * @brief Gets header of the open image
+     */
+    const ImageFormat::Header& header() const {
+        return *reinterpret_cast<const ImageFormat::Header*>(data);
+    }
+
+    /**
+     * @brief Gets number of records of the section
+     */
+    uint32_t count(ImageFormat::Section section) const {
+        return header().sectionCounts[section];
+    }
+
+    /**
+     * @brief Gets records of the section
+     * @return Pointer to the first record
+     */
+    template <typename Record>
+    const Record* records(ImageFormat::Section section) const {
+        return reinterpret_cast<const Record*>(data + header().sectionOffsets[section]);
+    }
+
+    /**
+     * @brief Checks if the range lies inside the section
+     */
+    bool contains(ImageFormat::Section section, ImageFormat::Range range) const {
+        return range.first <= count(section) && range.count <= count(section) - range.first;
+    }
+
+    /**
+     * @brief Gets string by id
+     * @param id String id
+     * @return Text inside the mapped file, empty if the id is not valid
+     */
+    std::string_view text(uint32_t id) const;
+
+    /**
+     * @brief Reads value record
+     * @param record Record of the value
+     * @return Value, strings are copied out of the image
+     */
+    Value value(const ImageFormat::ValueRecord& record) const;
+
+    /**
+     * @brief Reads compiled program
+     * @param index Index of the program
+     * @param program Receives the program
+     * @param result Values the program leaves on the stack, 1 for a guard and 0 for an action
+     * @return false if the record refers outside of the image or its stack use does not check out
+     */
+    bool program(uint32_t index, Program& program, int result) const;
+
+    /**
+     * @brief Converts JSON machine file to image file
+     * @param jsonFile Machine saved by MooreMachine::createJSONFile()
+     * @param imageFile Image to write
+     * @return true if the image was written
+     */
+    static bool convert(const std::string& jsonFile, const std::string& imageFile);
+};
+
+/**
+ * @class MachineImageBuilder
+ * @brief Collects records of an image and writes them to a file
+ */
+class MachineImageBuilder {
+private:
+    // Header being filled
+    ImageFormat::Header header{};
+
+    // Bytes of strings
+    std::string chars;
+
+    // Records of the sections
+    std::vector<ImageFormat::StringRecord> strings;
+    std::vector<uint32_t> ids;
+    std::vector<ImageFormat::ValueRecord> values;
+    std::vector<ImageFormat::InstructionRecord> instructions;
+    std::vector<ImageFormat::ProgramRecord> programs;
+    std::vector<ImageFormat::VariableRecord> variables;
+    std::vector<ImageFormat::TransitionRecord> transitions;
+    std::vector<ImageFormat::StateRecord> states;
+
+    // Interned strings
+    std::unordered_map<std::string, uint32_t> stringIds;
+
+public:
+    /**
+     * @brief Gets header, its ranges and machine fields are filled by the caller
+     */
+    ImageFormat::Header& getHeader() {
+        return header;
+    }
+
+    /**
+     * @brief Interns string
+     * @return String id
+     */
+    uint32_t addString(std::string_view text);
+
+    /**
+     * @brief Adds list of strings
+     * @return Range of their ids in the Ids section
+     */
+    ImageFormat::Range addStrings(const std::vector<std::string>& texts);
+
+    /**
+     * @brief Adds list of ints
+     * @return Range in the Ids section
+     */
+    ImageFormat::Range addIds(const std::vector<int>& list);
+
+    /**
+     * @brief Converts value to its record
+     */
+    ImageFormat::ValueRecord valueRecord(const Value& value);
+
+    /**
+     * @brief Adds compiled program
+     * @return Index of the program
+     */
+    uint32_t addProgram(const Program& program);
+
+    /**
+     * @brief Adds declared variable
+     */
+    void addVariable(const ImageFormat::VariableRecord& record) {
+        variables.push_back(record);
+    }
+
+    /**
+     * @brief Adds compiled transition
+     */
+    void addTransition(const ImageFormat::TransitionRecord& record) {
+        transitions.push_back(record);
+    }
+
+    /**
+     * @brief Gets number of transitions added so far
+     */
+    uint32_t transitionCount() const {
+        return static_cast<uint32_t>(transitions.size());
+    }
+
+    /**
+     * @brief Adds state, its transitions have to be added right before it
+     */
+    void addState(const ImageFormat::StateRecord& record) {
+        states.push_back(record);
+    }
+
+    /**
+     * @brief Writes image to the file
+     * @param filename File to write
+     * @return true if the file was written
+     */
+    bool write(const std::string& filename);
+};
+
+#endif // MACHINEIMAGE_H
@@ -0,0 +1,257 @@
+/**
+ * @file MachineInstance.cpp
+ * @brief Implementation of the MachineInstance class
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#include <iostream>
+#include "CodeExecutor.h"
+#include "MachineInstance.h"
+
+using namespace std;
+
+MachineInstance::MachineInstance(shared_ptr<const MachineDefinition> definition) {
+    setDefinition(move(definition));
+}
+
+void MachineInstance::setDefinition(shared_ptr<const MachineDefinition> definition) {
+    this->definition = move(definition);
+    guardCaches.clear();
+    if (!this->definition) {
+        currentState = -1;
+        variables.clear();
+        currentOutput.clear();
+        return;
+    }
+
+    // Slots only grow while the machine is edited, so existing values stay at their slots
+    const vector<Variable>& declared = this->definition->variables;
+    if (variables.size() > declared.size()) {
+        variables.resize(declared.size());
+    }
+    for (size_t i = variables.size(); i < declared.size(); i++) {
+        variables.push_back(declared[i].value);
+    }
+    currentOutput.resize(this->definition->outputSlots.size());
+
+    if (currentState < 0 || currentState >= static_cast<int>(this->definition->states.size())) {
+        currentState = this->definition->startState;
+    }
+    variablesChanged();
+}
+
+void MachineInstance::setClock(shared_ptr<Clock> clock) {
+    this->clock = move(clock);
+    stateEnteredAt = this->clock->now();
+}
+
+void MachineInstance::reset() {
+    currentState = definition ? definition->startState : -1;
+    variables.clear();
+    if (definition) {
+        for (const auto& var : definition->variables) {
+            variables.push_back(var.value);
+        }
+    }
+    resetOutputs();
+    guardCaches.clear();
+    variablesChanged();
+    stateEnteredAt = clock->now();
+}
+
+void MachineInstance::start() {
+    if (currentState == -1) {
+        return;
+    }
+    stateEnteredAt = clock->now();
+    CodeExecutor executor(*this, "", "");
+    executor.executeStateExpr(definition->states[currentState].action.program);
+}
+
+void MachineInstance::resetOutputs() {
+    for (auto& value : currentOutput) {
+        value.clear();
+    }
+}
+
+const CompiledTransition* MachineInstance::selectTransition(CodeExecutor& executor, const string& inputName, const string& inputValue) {
+    if (currentState == -1) {
+        return nullptr;
+    }
+    return selectTransition(executor, definition->inputSlots.find(inputName), inputValue);
+}
+
+const CompiledTransition* MachineInstance::selectTransition(CodeExecutor& executor, int inputId, const string& inputValue) {
+    if (currentState == -1) {
+        return nullptr;
+    }
+
+    // Only transitions of the chosen input are candidates, they are stored next to each other
+    return definition->selectTransition(currentState, inputId, [&](const CompiledTransition& transition) {
+        return evaluateGuard(executor, transition, inputValue);
+    });
+}
+
+void MachineInstance::enterState(int state, CodeExecutor& executor) {
+    view().enterState(state, executor);
+}
+
+void MachineInstance::setCurrentState(int state) {
+    currentState = state;
+    stateEnteredAt = clock->now();
+}
+
+InstanceView MachineInstance::view() {
+    InstanceView result;
+    result.definition = definition.get();
+    result.currentState = &currentState;
+    result.variables = variables.data();
+    result.outputs = currentOutput.data();
+    result.enteredAt = &stateEnteredAt;
+    result.variablesVersion = &variablesVersion;
+    result.clock = clock.get();
+    return result;
+}
+
+const CompiledTransition* MachineInstance::processInput(const string& inputName, const string& inputValue) {
+    resetOutputs();
+    CodeExecutor executor(*this, inputName, inputValue);
+    const CompiledTransition* transition = selectTransition(executor, inputName, inputValue);
+    if (transition && view().getDelayValue(*transition) == -1) {
+        enterState(transition->nextState, executor);
+    }
+    return transition;
+}
+
+bool MachineInstance::evaluateGuard(CodeExecutor& executor, const CompiledTransition& transition, const string& inputValue) {
+    const Program& guard = transition.guard.program;
+    if (guard.readsTime) {
+        return executor.executeTransitionBoolExpr(guard);
+    }
+
+    // Guard is evaluated only for its own input, so the result depends on the input value and variables only
+    if (guardCaches.empty()) {
+        guardCaches.resize(definition->transitionCount);
+    }
+    GuardCache& cache = guardCaches[transition.id];
+    if (guard.readsVariables && cache.variablesVersion != variablesVersion) {
+        cache.results.clear();
+        cache.variablesVersion = variablesVersion;
+    }
+
+    auto it = cache.results.find(inputValue);
+    if (it != cache.results.end()) {
+        return it->second;
+    }
+
+    bool result = executor.executeTransitionBoolExpr(guard);
+    if (cache.results.size() >= GuardCache::maxEntries) {
+        cache.results.clear();
+    }
+    cache.results.emplace(inputValue, result);
+    return result;
+}
+
+void MachineInstance::setCurrentOutput(const string& outputName, string_view outputValue) {
+    int slot = definition->outputSlots.find(outputName);
+    if (slot == -1) {
+        cout << "Output \"" << outputName << "\" does not exist in machine" << endl;
+        return;
+    }
+
+    // Assign into the existing string so its buffer is reused
+    currentOutput[slot].assign(outputValue);
+}
+
+string MachineInstance::getCurrentOutput() const {
+    // Sized up front, so the text is built without reallocations
+    size_t size = 0;
+    for (size_t i = 0; i < currentOutput.size(); i++) {
+        size += definition->outputSlots.name(i).size() + 1 + currentOutput[i].size();
+    }
+    string result;
+    result.reserve(size);
+    for (size_t i = 0; i < currentOutput.size(); i++) {
+        result += definition->outputSlots.name(i);
+        result += ':';
+        result += currentOutput[i];
+    }
+    return result;
+}
+
+int MachineInstance::getElapsed() const {
+    return static_cast<int>(chrono::duration_cast<chrono::milliseconds>(clock->now() - stateEnteredAt).count());
+}
+
+string MachineInstance::saveSnapshot() const {
+    string data;
+    if (!definition) {
+        return data;
+    }
+    SnapshotWriter writer(data);
+    writer.header(Snapshot::Kind::Instance, *definition);
+    writeState(writer);
+    return data;
+}
+
+bool MachineInstance::restoreSnapshot(string_view data) {
+    if (!definition) {
+        cout << "Snapshot can not be restored into instance without machine" << endl;
+        return false;
+    }
+    SnapshotReader reader(data);
+    if (!reader.header(Snapshot::Kind::Instance, *definition) || !readState(reader)) {
+        return false;
+    }
+    if (!reader.finished()) {
+        cout << "Snapshot has unexpected data at the end" << endl;
+    }
+    return true;
+}
+
+void MachineInstance::writeState(SnapshotWriter& writer) const {
+    writer.i32(currentState);
+    writer.u64(static_cast<uint64_t>(chrono::duration_cast<chrono::microseconds>(clock->now() - stateEnteredAt).count()));
+    writer.u32(static_cast<uint32_t>(variables.size()));
+    for (const Value& value : variables) {
+        writer.value(value);
+    }
+    writer.u32(static_cast<uint32_t>(currentOutput.size()));
+    for (const string& output : currentOutput) {
+        writer.text(output);
+    }
+}
+
+bool MachineInstance::readState(SnapshotReader& reader) {
+    // Everything is read aside first, so malformed data does not leave half restored instance
+    int state = reader.i32();
+    chrono::microseconds elapsed(static_cast<int64_t>(reader.u64()));
+    if (reader.u32() != definition->variables.size() || !reader.ok()) {
+        cout << "Snapshot is damaged" << endl;
+        return false;
+    }
+    vector<Value> values(definition->variables.size());
+    for (Value& value : values) {
+        reader.value(value);
+    }
+    if (reader.u32() != currentOutput.size() || !reader.ok()) {
+        cout << "Snapshot is damaged" << endl;
+        return false;
+    }
+    vector<string> outputs(currentOutput.size());
+    for (string& output : outputs) {
+        reader.text(output);
+    }
+    if (!reader.ok() || state < -1 || state >= static_cast<int>(definition->states.size())) {
+        cout << "Snapshot is damaged" << endl;
+        return false;
+    }
+
+    currentState = state;
+    variables = move(values);
+    currentOutput = move(outputs);
+    stateEnteredAt = clock->now() - chrono::duration_cast<Clock::TimePoint::duration>(elapsed);
+    guardCaches.clear();
+    variablesChanged();
+    return true;
+}
@@ -0,0 +1,257 @@
+/**
+ * @file MachineInstance.h
+ * @brief Header file for the MachineInstance class, runtime state of one running automaton
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#ifndef MACHINEINSTANCE_H
+#define MACHINEINSTANCE_H
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Clock.h"
+#include "InstanceView.h"
+#include "MachineDefinition.h"
+#include "Snapshot.h"
+#include "Value.h"
+
+class CodeExecutor;
+
+/**
+ * @class MachineInstance
+ * @brief Mutable part of a running Moore machine, the automaton itself is a shared MachineDefinition
+ *
+ * Instance holds only the current state, values of the variables, the output row
+ * and guard caches, so thousands of them can run one definition.
+ * Delays are not waited for here, the caller decides when a delayed transition fires.
+ */
+class MachineInstance {
+private:
+    // Automaton being run
+    std::shared_ptr<const MachineDefinition> definition;
+
+    // Index of the current state, -1 before the instance is bound to a definition
+    int currentState = -1;
+
+    // Values of the variables, index is the variable slot
+    std::vector<Value> variables;
+
+    // Output of the current state, indexed by output slot
+    std::vector<std::string> currentOutput;
+
+    // Memoised guard results, indexed by CompiledTransition::id, allocated on first use
+    std::vector<GuardCache> guardCaches;
+
+    // Incremented on every write to a variable, invalidates cached guards that read variables
+    unsigned long variablesVersion = 0;
+
+    // Time source for elapsed()
+    std::shared_ptr<Clock> clock = Clock::real();
+
+    // Time when the current state was entered, used by elapsed()
+    std::chrono::steady_clock::time_point stateEnteredAt = clock->now();
+
+    /**
+     * @brief Evaluates guard of the transition, reuses result computed for the same input value
+     * @param executor Executor of the current event
+     * @param transition Compiled transition
+     * @param inputValue Value of the current input
+     * @return true if the transition can be taken
+     */
+    bool evaluateGuard(CodeExecutor& executor, const CompiledTransition& transition, const std::string& inputValue);
+
+public:
+    /**
+     * @brief Creates instance not bound to any definition
+     */
+    MachineInstance() = default;
+
+    /**
+     * @brief Creates instance in the start state of the definition
+     * @param definition Automaton to run
+     */
+    explicit MachineInstance(std::shared_ptr<const MachineDefinition> definition);
+
+    /**
+     * @brief Binds instance to a new version of the definition, keeps current state and variables that still exist
+     * @param definition Automaton to run
+     */
+    void setDefinition(std::shared_ptr<const MachineDefinition> definition);
+
+    /**
+     * @brief Gets the automaton being run
+     * @return Shared definition, nullptr if the instance is not bound
+     */
+    const std::shared_ptr<const MachineDefinition>& getDefinition() const {
+        return definition;
+    }
+
+    /**
+     * @brief Sets time source of the instance, time in the current state starts from now
+     * @param clock Clock to use
+     */
+    void setClock(std::shared_ptr<Clock> clock);
+
+    /**
+     * @brief Gets time source of the instance
+     */
+    const std::shared_ptr<Clock>& getClock() const {
+        return clock;
+    }
+
+    /**
+     * @brief Returns to the start state with initial values of variables and empty outputs
+     */
+    void reset();
+
+    /**
+     * @brief Executes action of the current state, used when the simulation starts
+     */
+    void start();
+
+    /**
+     * @brief Sets all outputs to empty string
+     */
+    void resetOutputs();
+
+    /**
+     * @brief Finds first transition of the current state the input takes
+     * @param executor Executor of the current event
+     * @param inputName Input name
+     * @param inputValue Input value
+     * @return Taken transition, nullptr if there is none
+     */
+    const CompiledTransition* selectTransition(CodeExecutor& executor, const std::string& inputName, const std::string& inputValue);
+
+    /**
+     * @brief Finds first transition of the current state the input takes
+     * @param executor Executor of the current event
+     * @param inputId Id of the input in the definition's inputSlots, -1 if the input is unknown
+     * @param inputValue Input value
+     * @return Taken transition, nullptr if there is none
+     */
+    const CompiledTransition* selectTransition(CodeExecutor& executor, int inputId, const std::string& inputValue);
+
+    /**
+     * @brief Moves to the state and executes its action, constant actions are copied from the cached row
+     * @param state Index of the state
+     * @param executor Executor of the current event
+     */
+    void enterState(int state, CodeExecutor& executor);
+
+    /**
+     * @brief Moves to the state without executing its action
+     * @param state Index of the state
+     */
+    void setCurrentState(int state);
+
+    /**
+     * @brief Processes one input, delayed transitions are left to the caller
+     *
+     * Outputs are reset, the first transition the input takes is found and if it has
+     * no delay its target state is entered. Caller enters the target of a delayed
+     * transition with enterState() once the delay passes.
+     *
+     * @param inputName Input name
+     * @param inputValue Input value
+     * @return Taken transition, nullptr if there is none
+     */
+    const CompiledTransition* processInput(const std::string& inputName, const std::string& inputValue);
+
+    /**
+     * @brief Gets view the VM uses to access this instance, valid until the definition changes
+     * @return View of the instance
+     */
+    InstanceView view();
+
+    /**
+     * @brief Gets index of the current state
+     * @return Current state
+     */
+    int getCurrentState() const {
+        return currentState;
+    }
+
+    /**
+     * @brief Gets value of the variable
+     * @param slot Variable slot
+     * @return Reference to the value, caller has to call variablesChanged() after writing
+     */
+    Value& variable(int slot) {
+        return variables[slot];
+    }
+
+    /**
+     * @brief Gets values of all variables
+     * @return Values indexed by variable slot
+     */
+    const std::vector<Value>& getVariables() const {
+        return variables;
+    }
+
+    /**
+     * @brief Marks variables as changed
+     */
+    void variablesChanged() {
+        variablesVersion++;
+    }
+
+    /**
+     * @brief Sets output value
+     * @param outputName Output name
+     * @param outputValue Output value
+     */
+    void setCurrentOutput(const std::string& outputName, std::string_view outputValue);
+
+    /**
+     * @brief Gets output of the current state
+     * @return Values indexed by output slot of the definition
+     */
+    const std::vector<std::string>& getOutputs() const {
+        return currentOutput;
+    }
+
+    /**
+     * @brief Gets current output as string
+     * @return Formatted current output
+     */
+    std::string getCurrentOutput() const;
+
+    /**
+     * @brief Gets time spent in the current state
+     * @return Milliseconds since the current state was entered
+     */
+    int getElapsed() const;
+
+    /**
+     * @brief Creates binary snapshot of the current state, variables, outputs and time in the state
+     * @return Snapshot, restorable into an instance of the same definition
+     */
+    std::string saveSnapshot() const;
+
+    /**
+     * @brief Restores state saved by saveSnapshot()
+     * @param data Snapshot
+     * @return false if the snapshot does not fit the definition, the instance is left untouched then
+     */
+    bool restoreSnapshot(std::string_view data);
+
+    /**
+     * @brief Writes runtime state without the snapshot header, used by snapshots of the owner
+     * @param writer Snapshot being written
+     */
+    void writeState(SnapshotWriter& writer) const;
+
+    /**
+     * @brief Reads state written by writeState(), the header was already checked by the caller
+     * @param reader Snapshot being read
+     * @return false if the data is malformed, the instance is left untouched then
+     */
+    bool readState(SnapshotReader& reader);
+};
+
+#endif // MACHINEINSTANCE_H
@@ -0,0 +1,194 @@
+/**
+ * @file MachineJsonReader.cpp
+ * @brief Implementation of the MachineJsonReader class
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#include <algorithm>
+#include <iostream>
+#include "MachineJsonReader.h"
+
+using namespace std;
+
+bool MachineJsonReader::read(istream& input) {
+    path.clear();
+    pending = Key::Root;
+    return nlohmann::json::sax_parse(input, this);
+}
+
+MachineJsonReader::Key MachineJsonReader::keyOf(const std::string& text) {
+    static const pair<const char*, Key> keys[] = {
+        {"name", Key::Name}, {"description", Key::Description}, {"inputs", Key::Inputs},
+        {"outputs", Key::Outputs}, {"variables", Key::Variables}, {"states", Key::States},
+        {"transitions", Key::Transitions}, {"type", Key::Type}, {"value", Key::Value},
+        {"outputExpr", Key::OutputExpr}, {"expression", Key::Expression}, {"inputEvent", Key::InputEvent},
+        {"boolExpr", Key::BoolExpr}, {"delay", Key::Delay}, {"nextState", Key::NextState},
+    };
+    for (const auto& [name, key] : keys) {
+        if (text == name) {
+            return key;
+        }
+    }
+    return Key::Other;
+}
+
+bool MachineJsonReader::at(initializer_list<Key> keys) const {
+    return path.size() == keys.size() && equal(path.begin(), path.end(), keys.begin());
+}
+
+void MachineJsonReader::scalar(std::string& value) {
+    if (at({Key::Root})) {
+        if (pending == Key::Name) {
+            name = move(value);
+        }
+        else if (pending == Key::Description) {
+            description = move(value);
+        }
+    }
+    else if (at({Key::Root, Key::Inputs})) {
+        inputs.push_back(move(value));
+    }
+    else if (at({Key::Root, Key::Outputs})) {
+        outputs.push_back(move(value));
+    }
+    else if (at({Key::Root, Key::Variables, Key::Item})) {
+        Variable& var = variables.back();
+        if (pending == Key::Type) {
+            var.type = move(value);
+        }
+        else if (pending == Key::Name) {
+            var.name = move(value);
+        }
+        else if (pending == Key::Value) {
+            variableValue = move(value);
+        }
+    }
+    else if (at({Key::Root, Key::States, Key::Item})) {
+        if (pending == Key::Name) {
+            states.back().name = move(value);
+        }
+        else if (pending == Key::OutputExpr) {
+            states.back().outputExpr = move(value);
+        }
+    }
+    else if (at({Key::Root, Key::Transitions, Key::Item})) {
+        if (pending == Key::Name) {
+            blocks.back().name = move(value);
+        }
+    }
+    else if (at({Key::Root, Key::Transitions, Key::Item, Key::Transitions, Key::Item})) {
+        if (pending == Key::NextState) {
+            transitions.back().nextState = move(value);
+        }
+    }
+    else if (at({Key::Root, Key::Transitions, Key::Item, Key::Transitions, Key::Item, Key::Expression})) {
+        TransitionExpression& expr = transitions.back().expr;
+        if (pending == Key::InputEvent) {
+            expr.inputEvent = move(value);
+        }
+        else if (pending == Key::BoolExpr) {
+            expr.boolExpr = move(value);
+        }
+        else if (pending == Key::Delay) {
+            expr.delay = move(value);
+        }
+    }
+}
+
+bool MachineJsonReader::null() {
+    std::string text;
+    scalar(text);
+    return true;
+}
+
+bool MachineJsonReader::boolean(bool value) {
+    std::string text = value ? "true" : "false";
+    scalar(text);
+    return true;
+}
+
+bool MachineJsonReader::number_integer(number_integer_t value) {
+    std::string text = to_string(value);
+    scalar(text);
+    return true;
+}
+
+bool MachineJsonReader::number_unsigned(number_unsigned_t value) {
+    std::string text = to_string(value);
+    scalar(text);
+    return true;
+}
+
+bool MachineJsonReader::number_float(number_float_t, const string_t& text) {
+    std::string copy = text;
+    scalar(copy);
+    return true;
+}
+
+bool MachineJsonReader::string(string_t& value) {
+    scalar(value);
+    return true;
+}
+
+bool MachineJsonReader::binary(binary_t&) {
+    return true;
+}
+
+bool MachineJsonReader::start_object(size_t) {
+    path.push_back(pending);
+
+    // Items are created when they start, their fields may come in any order
+    if (at({Key::Root, Key::Variables, Key::Item})) {
+        variables.emplace_back();
+        variableValue.clear();
+    }
+    else if (at({Key::Root, Key::States, Key::Item})) {
+        states.emplace_back();
+    }
+    else if (at({Key::Root, Key::Transitions, Key::Item})) {
+        blocks.emplace_back();
+        blocks.back().first = transitions.size();
+    }
+    else if (at({Key::Root, Key::Transitions, Key::Item, Key::Transitions, Key::Item})) {
+        transitions.emplace_back();
+    }
+    pending = Key::Other;
+    return true;
+}
+
+bool MachineJsonReader::key(string_t& value) {
+    pending = keyOf(value);
+    return true;
+}
+
+bool MachineJsonReader::end_object() {
+    if (at({Key::Root, Key::Variables, Key::Item})) {
+        Variable& var = variables.back();
+        var.value = Value::parse(var.type, variableValue);
+    }
+    else if (at({Key::Root, Key::Transitions, Key::Item})) {
+        blocks.back().count = transitions.size() - blocks.back().first;
+    }
+
+    // Inside an object the next key() replaces it
+    path.pop_back();
+    pending = Key::Item;
+    return true;
+}
+
+bool MachineJsonReader::start_array(size_t) {
+    path.push_back(pending);
+    pending = Key::Item;
+    return true;
+}
+
+bool MachineJsonReader::end_array() {
+    path.pop_back();
+    pending = Key::Item;
+    return true;
+}
+
+bool MachineJsonReader::parse_error(size_t position, const std::string&, const nlohmann::detail::exception& error) {
+    cout << "Failed to parse machine at byte " << position << ": " << error.what() << endl;
+    return false;
+}
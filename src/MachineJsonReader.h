@@ -0,0 +1,123 @@
+/**
+ * @file MachineJsonReader.h
+ * @brief Header file for the MachineJsonReader class, streaming reader of machine JSON files
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#ifndef MACHINEJSONREADER_H
+#define MACHINEJSONREADER_H
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+#include "json.hpp"
+#include "Structs.h"
+
+/**
+ * @class MachineJsonReader
+ * @brief Reads machine saved by MooreMachine::createJSONFile() through SAX events
+ *
+ * No DOM is built, values are moved into the fields below as the parser reports
+ * them, so memory is proportional to the machine and not to the text. Names of
+ * states are kept as they are, MooreMachine resolves them once everything is read.
+ * Keys the format does not know are skipped, missing keys leave empty values.
+ */
+class MachineJsonReader : public nlohmann::json_sax<nlohmann::json> {
+public:
+    /**
+     * @struct StateEntry
+     * @brief Item of "states"
+     */
+    struct StateEntry {
+        std::string name; // Name of the state
+        std::string outputExpr; // Output expression
+    };
+
+    /**
+     * @struct TransitionEntry
+     * @brief Transition of one "transitions" block
+     */
+    struct TransitionEntry {
+        TransitionExpression expr; // Expression of the transition
+        std::string nextState; // Name of the target state
+    };
+
+    /**
+     * @struct TransitionBlock
+     * @brief Item of "transitions", transitions of one state
+     */
+    struct TransitionBlock {
+        std::string name; // Name of the source state
+        size_t first = 0; // Index of the first transition in transitions
+        size_t count = 0; // Number of the transitions
+    };
+
+    std::string name; // Name of the machine
+    std::string description; // Description of the machine
+    std::vector<std::string> inputs; // Declared inputs
+    std::vector<std::string> outputs; // Declared outputs
+    std::vector<Variable> variables; // Declared variables, in file order
+    std::vector<StateEntry> states; // States, in file order
+    std::vector<TransitionBlock> blocks; // Transition blocks, in file order
+    std::vector<TransitionEntry> transitions; // Transitions of all blocks
+
+    /**
+     * @brief Reads the whole stream, prints the reason if it is not valid JSON
+     * @param input Stream with the machine
+     * @return true if the stream was read
+     */
+    bool read(std::istream& input);
+
+    bool null() override;
+    bool boolean(bool value) override;
+    bool number_integer(number_integer_t value) override;
+    bool number_unsigned(number_unsigned_t value) override;
+    bool number_float(number_float_t value, const string_t& text) override;
+    bool string(string_t& value) override;
+    bool binary(binary_t& value) override;
+    bool start_object(std::size_t elements) override;
+    bool key(string_t& value) override;
+    bool end_object() override;
+    bool start_array(std::size_t elements) override;
+    bool end_array() override;
+    bool parse_error(std::size_t position, const std::string& token, const nlohmann::detail::exception& error) override;
+
+private:
+    /**
+     * @enum Key
+     * @brief Keys of the format, everything else is Other
+     */
+    enum class Key : uint8_t {
+        Root, Item, Other, Name, Description, Inputs, Outputs, Variables, States, Transitions,
+        Type, Value, OutputExpr, Expression, InputEvent, BoolExpr, Delay, NextState
+    };
+
+    // Keys of the containers from the root to the current one, Item for array elements
+    std::vector<Key> path;
+
+    // Key of the value that comes next, Item inside arrays
+    Key pending = Key::Root;
+
+    // Text of the variable value, parsed once its type is known
+    std::string variableValue;
+
+    /**
+     * @brief Maps key text to Key
+     */
+    static Key keyOf(const std::string& text);
+
+    /**
+     * @brief Checks if the path ends with the keys
+     */
+    bool at(std::initializer_list<Key> keys) const;
+
+    /**
+     * @brief Stores scalar value at the current position, numbers and bools come as text
+     * @param value Text of the value, moved from
+     */
+    void scalar(std::string& value);
+};
+
+#endif // MACHINEJSONREADER_H
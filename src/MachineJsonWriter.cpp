@@ -0,0 +1,198 @@
+/**
+ * @file MachineJsonWriter.cpp
+ * @brief Implementation of the MachineJsonWriter class
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#include <algorithm>
+#include "MachineJsonWriter.h"
+
+using namespace std;
+
+void MachineJsonWriter::indent() {
+    static const char spaces[] = "                                ";
+    size_t width = counts.size() * 4;
+    while (width > 0) {
+        size_t chunk = min(width, sizeof(spaces) - 1);
+        out.write(spaces, static_cast<streamsize>(chunk));
+        width -= chunk;
+    }
+}
+
+void MachineJsonWriter::next() {
+    if (counts.empty()) {
+        return;
+    }
+    out << (counts.back() > 0 ? ",\n" : "\n");
+    indent();
+    counts.back()++;
+}
+
+void MachineJsonWriter::open(char bracket) {
+    out << bracket;
+    counts.push_back(0);
+}
+
+void MachineJsonWriter::close(char bracket) {
+    // Empty container stays on one line, like dump() writes it
+    int written = counts.back();
+    counts.pop_back();
+    if (written > 0) {
+        out << '\n';
+        indent();
+    }
+    out << bracket;
+}
+
+void MachineJsonWriter::key(string_view name) {
+    next();
+    quoted(name);
+    out << ": ";
+}
+
+void MachineJsonWriter::member(string_view name, string_view value) {
+    key(name);
+    quoted(value);
+}
+
+void MachineJsonWriter::element(string_view value) {
+    next();
+    quoted(value);
+}
+
+void MachineJsonWriter::quoted(string_view value) {
+    static const char hex[] = "0123456789abcdef";
+    out << '"';
+
+    // Runs of characters that need no escaping are written at once
+    size_t start = 0;
+    for (size_t i = 0; i < value.size(); i++) {
+        unsigned char ch = static_cast<unsigned char>(value[i]);
+        if (ch >= 0x20 && ch != '"' && ch != '\\') {
+            continue;
+        }
+        out.write(value.data() + start, static_cast<streamsize>(i - start));
+        start = i + 1;
+        switch (ch) {
+            case '"':
+                out << "\\\"";
+                break;
+            case '\\':
+                out << "\\\\";
+                break;
+            case '\b':
+                out << "\\b";
+                break;
+            case '\f':
+                out << "\\f";
+                break;
+            case '\n':
+                out << "\\n";
+                break;
+            case '\r':
+                out << "\\r";
+                break;
+            case '\t':
+                out << "\\t";
+                break;
+            default:
+                out << "\\u00" << hex[ch >> 4] << hex[ch & 0xf];
+                break;
+        }
+    }
+    out.write(value.data() + start, static_cast<streamsize>(value.size() - start));
+    out << '"';
+}
+
+void MachineJsonWriter::enter(Section target) {
+    static const char* const names[] = {"", "variables", "states", "transitions"};
+    while (section < target) {
+        if (section != Section::None) {
+            close(']');
+        }
+        section = static_cast<Section>(static_cast<int>(section) + 1);
+        key(names[static_cast<int>(section)]);
+        open('[');
+    }
+}
+
+void MachineJsonWriter::closeBlock() {
+    if (inBlock) {
+        close(']');
+        close('}');
+        inBlock = false;
+    }
+}
+
+void MachineJsonWriter::machine(const string& name, const string& description,
+                                const vector<string>& inputs, const vector<string>& outputs) {
+    counts.clear();
+    section = Section::None;
+    inBlock = false;
+
+    open('{');
+    member("name", name);
+    member("description", description);
+    key("inputs");
+    open('[');
+    for (const auto& input : inputs) {
+        element(input);
+    }
+    close(']');
+    key("outputs");
+    open('[');
+    for (const auto& output : outputs) {
+        element(output);
+    }
+    close(']');
+}
+
+void MachineJsonWriter::variable(const Variable& var) {
+    enter(Section::Variables);
+    next();
+    open('{');
+    member("type", var.type);
+    member("name", var.name);
+    member("value", var.value.toString());
+    close('}');
+}
+
+void MachineJsonWriter::state(const State& state) {
+    enter(Section::States);
+    next();
+    open('{');
+    member("name", state.name);
+    member("outputExpr", state.outputExpr);
+    close('}');
+}
+
+void MachineJsonWriter::transitions(const State& state) {
+    enter(Section::Transitions);
+    closeBlock();
+    next();
+    open('{');
+    member("name", state.name);
+    key("transitions");
+    open('[');
+    inBlock = true;
+}
+
+void MachineJsonWriter::transition(const TransitionExpression& expr, const string& nextState) {
+    next();
+    open('{');
+    key("expression");
+    open('{');
+    member("inputEvent", expr.inputEvent);
+    member("boolExpr", expr.boolExpr);
+    member("delay", expr.delay);
+    close('}');
+    member("nextState", nextState);
+    close('}');
+}
+
+void MachineJsonWriter::end() {
+    enter(Section::Transitions);
+    closeBlock();
+    close(']');
+    close('}');
+}
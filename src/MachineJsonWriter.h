@@ -0,0 +1,113 @@
+/**
+ * @file MachineJsonWriter.h
+ * @brief Header file for the MachineJsonWriter class, streaming writer of machine JSON files
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#ifndef MACHINEJSONWRITER_H
+#define MACHINEJSONWRITER_H
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "MachineVisitor.h"
+
+/**
+ * @class MachineJsonWriter
+ * @brief Writes machine as JSON text straight to a stream, no JSON tree is built
+ *
+ * Output is the same as nlohmann::ordered_json::dump(4) of the machine, so files
+ * saved before stay byte for byte the same.
+ */
+class MachineJsonWriter : public MachineVisitor {
+private:
+    /**
+     * @enum Section
+     * @brief Top level array being written
+     */
+    enum class Section { None, Variables, States, Transitions };
+
+    // Stream the text goes to
+    std::ostream& out;
+
+    // Number of elements written into each open container, innermost last
+    std::vector<int> counts;
+
+    // Top level array being written
+    Section section = Section::None;
+
+    // Transitions of a state are being written
+    bool inBlock = false;
+
+    /**
+     * @brief Writes indentation of the current depth
+     */
+    void indent();
+
+    /**
+     * @brief Writes separator and indentation of the next element of the open container
+     */
+    void next();
+
+    /**
+     * @brief Opens object or array as the next element
+     * @param bracket '{' or '['
+     */
+    void open(char bracket);
+
+    /**
+     * @brief Closes the innermost container
+     * @param bracket '}' or ']'
+     */
+    void close(char bracket);
+
+    /**
+     * @brief Writes key of the next member, its value follows
+     */
+    void key(std::string_view name);
+
+    /**
+     * @brief Writes string member
+     */
+    void member(std::string_view name, std::string_view value);
+
+    /**
+     * @brief Writes string as the next element of the open array
+     */
+    void element(std::string_view value);
+
+    /**
+     * @brief Writes quoted and escaped string
+     */
+    void quoted(std::string_view value);
+
+    /**
+     * @brief Closes the open top level array and opens the next one, empty sections are opened too
+     * @param target Section to open
+     */
+    void enter(Section target);
+
+    /**
+     * @brief Closes transitions of the previous state
+     */
+    void closeBlock();
+
+public:
+    /**
+     * @brief Creates writer
+     * @param out Stream to write to
+     */
+    explicit MachineJsonWriter(std::ostream& out) : out(out) {}
+
+    void machine(const std::string& name, const std::string& description,
+                 const std::vector<std::string>& inputs, const std::vector<std::string>& outputs) override;
+    void variable(const Variable& var) override;
+    void state(const State& state) override;
+    void transitions(const State& state) override;
+    void transition(const TransitionExpression& expr, const std::string& nextState) override;
+    void end() override;
+};
+
+#endif // MACHINEJSONWRITER_H
@@ -0,0 +1,68 @@
+/**
+ * @file MachineVisitor.h
+ * @brief Interface receiving parts of a machine in the order they are saved
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#ifndef MACHINEVISITOR_H
+#define MACHINEVISITOR_H
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Structs.h"
+
+/**
+ * @class MachineVisitor
+ * @brief Receives the machine from MooreMachine::serialize() part by part
+ *
+ * Calls come in the order of the JSON file: machine(), every variable, every state,
+ * then for every state transitions() followed by its transition() calls, and
+ * finally end(). Nothing is copied, references are valid only during the call.
+ */
+class MachineVisitor {
+public:
+    virtual ~MachineVisitor() = default;
+
+    /**
+     * @brief Starts the machine
+     * @param name Name of the machine
+     * @param description Description of the machine
+     * @param inputs Declared inputs
+     * @param outputs Declared outputs
+     */
+    virtual void machine(const std::string& name, const std::string& description,
+                         const std::vector<std::string>& inputs, const std::vector<std::string>& outputs) = 0;
+
+    /**
+     * @brief Receives declared variable
+     * @param var Variable with its initial value
+     */
+    virtual void variable(const Variable& var) = 0;
+
+    /**
+     * @brief Receives state, its transitions come later
+     * @param state State
+     */
+    virtual void state(const State& state) = 0;
+
+    /**
+     * @brief Starts transitions of the state
+     * @param state Source state
+     */
+    virtual void transitions(const State& state) = 0;
+
+    /**
+     * @brief Receives transition of the state passed to the last transitions()
+     * @param expr Expression of the transition
+     * @param nextState Name of the target state
+     */
+    virtual void transition(const TransitionExpression& expr, const std::string& nextState) = 0;
+
+    /**
+     * @brief Ends the machine
+     */
+    virtual void end() = 0;
+};
+
+#endif // MACHINEVISITOR_H
@@ -11,16 +11,21 @@
 #include <unordered_set>
 #include <algorithm>
 #include "CodeExecutor.h"
+#include "ExprCompiler.h"
+#include "ExprParser.h"
+#include "ExprOptimizer.h"
+#include "MachineImage.h"
+#include "MachineJsonReader.h"
+#include "MachineJsonWriter.h"
 #include "MooreMachine.h"
 #include <fstream>
-#include <thread>
 #include <chrono>
 
 using namespace std;
 
 void MooreMachine::dfs(int state, unordered_set<int>& visited) {
     visited.insert(state);
-    for (const auto& transition : states[state].transitions) {
+    for (const auto& transition : currentStates()[state].transitions) {
         int nextState = transition.second;
         if (visited.find(nextState) == visited.end()) {
             dfs(nextState, visited);
@@ -84,6 +89,235 @@ TransitionExpression MooreMachine::parseExpr(const string& expr) {
     return parsedExpr;
 }
 
+void MooreMachine::compileState(State& state, const AstPtr& action) {
+    AstPtr optimizedAction = ExprOptimizer(constantVariables).optimize(action);
+
+    // Every output the action writes gets its place in the output row
+    unordered_set<string> written;
+    ExprOptimizer::collectOutputs(optimizedAction, written);
+    for (const auto& output : written) {
+        outputSlots.intern(output);
+    }
+
+    state.action = {optimizedAction, ExprCompiler::compile(optimizedAction, variableSlots, outputSlots)};
+    state.outputRow.clear();
+    state.constantAction = buildOutputRow(optimizedAction, state.outputRow);
+    if (!state.constantAction) {
+        state.outputRow.clear();
+    }
+
+    compileTransitions(state);
+}
+
+void MooreMachine::compileTransitions(State& state) {
+    vector<pair<int, const pair<const TransitionExpression, int>*>> byInput;
+    for (const auto& transition : state.transitions) {
+        byInput.emplace_back(inputSlots.intern(transition.first.inputEvent), &transition);
+    }
+    stable_sort(byInput.begin(), byInput.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first;
+    });
+
+    // Count transitions of every input, then turn the counts into start offsets
+    // Transitions whose guard is statically false are not candidates, State::transitions keeps them for saving
+    state.inputRuns.assign(inputSlots.size() + 1, 0);
+    state.compiled.clear();
+    state.compiled.reserve(byInput.size());
+    for (const auto& [inputId, transition] : byInput) {
+        CompiledTransition compiled = compileTransition(transition->first);
+        if (compiled.neverTaken) {
+            continue;
+        }
+        compiled.nextState = transition->second;
+        state.inputRuns[inputId + 1]++;
+        state.compiled.push_back(move(compiled));
+    }
+    for (size_t i = 1; i < state.inputRuns.size(); i++) {
+        state.inputRuns[i] += state.inputRuns[i - 1];
+    }
+}
+
+bool MooreMachine::buildOutputRow(const AstPtr& action, vector<string>& row) {
+    if (!action) {
+        return true;
+    }
+
+    if (action->kind == AstKind::Block) {
+        for (const auto& statement : action->children) {
+            if (!buildOutputRow(statement, row)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    if (action->kind != AstKind::Output || !ExprOptimizer::isConstant(*action->children[0])) {
+        return false;
+    }
+
+    int slot = outputSlots.intern(action->text);
+    if (static_cast<int>(row.size()) < outputSlots.size()) {
+        row.resize(outputSlots.size());
+    }
+    row[slot] = ExprOptimizer::constantValue(*action->children[0]).toString();
+    return true;
+}
+
+shared_ptr<const MachineDefinition> MooreMachine::getDefinition() {
+    if (definition) {
+        return definition;
+    }
+
+    for (const auto& output : outputs) {
+        outputSlots.intern(output);
+    }
+
+    // Declared inputs get ids even if no transition reads them, so their events can be batched
+    inputSlots.intern("");
+    for (const auto& input : inputs) {
+        inputSlots.intern(input);
+    }
+
+    // States are moved, not copied, the machine reads them from the definition until it changes
+    auto built = make_shared<MachineDefinition>();
+    built->states = move(states);
+    states.clear();
+    built->variables = variables;
+    built->inputs = inputs;
+    built->outputs = outputs;
+    built->variableSlots = variableSlots;
+    built->inputSlots = inputSlots;
+    built->outputSlots = outputSlots;
+    built->startState = startState;
+    for (auto& state : built->states) {
+        // Rows of constant actions were built before later outputs got their slots
+        if (state.constantAction) {
+            state.outputRow.resize(outputSlots.size());
+        }
+        for (auto& transition : state.compiled) {
+            transition.id = built->transitionCount++;
+        }
+    }
+
+    definition = built;
+    return definition;
+}
+
+void MooreMachine::takeStates() {
+    if (!definition) {
+        return;
+    }
+
+    // Instances of other owners may still run the old definition, then the states are copied back
+    long owners = instance.getDefinition() == definition ? 2 : 1;
+    if (definition.use_count() == owners) {
+        states = move(definition->states);
+    }
+    else {
+        states = definition->states;
+    }
+    definition.reset();
+}
+
+void MooreMachine::setClock(shared_ptr<Clock> clock) {
+    // Timers count ticks of the old clock, delays in progress are dropped
+    interruptDelay();
+    timers.reset();
+    this->clock = clock;
+    instance.setClock(move(clock));
+}
+
+void MooreMachine::syncInstance() {
+    shared_ptr<const MachineDefinition> current = getDefinition();
+    if (instance.getDefinition() != current) {
+        instance.setDefinition(current);
+    }
+}
+
+void MooreMachine::compileNewState(State& state) {
+    AstPtr action = ExprParser::parseAction(state.outputExpr);
+
+    // Assignment to a variable that was folded as constant invalidates all compiled code
+    unordered_set<string> assigned;
+    ExprOptimizer::collectAssigned(action, assigned);
+    for (const auto& name : assigned) {
+        if (constantVariables.count(name)) {
+            compileAll();
+            return;
+        }
+    }
+
+    compileState(state, action);
+}
+
+CompiledTransition MooreMachine::compileTransition(const TransitionExpression& expr) {
+    CompiledTransition compiled;
+    compiled.hasInput = expr.inputEvent != "";
+    compiled.hasGuard = expr.boolExpr != "";
+    compiled.hasDelay = expr.delay != "";
+
+    AstPtr guard = ExprParser::parseGuard(expr.boolExpr);
+    if (!guard && removeSpaces(expr.boolExpr) != "") {
+        // Guard that does not compile can never be fulfilled
+        compiled.neverTaken = true;
+    }
+
+    // Guard is evaluated only when its input arrives, so the input is known while folding
+    guard = ExprOptimizer(constantVariables, &expr.inputEvent).optimize(guard);
+    if (guard && ExprOptimizer::isConstant(*guard)) {
+        Value result = ExprOptimizer::constantValue(*guard);
+        if (result.getType() == ValueType::Bool) {
+            compiled.neverTaken = !result.asBool();
+            guard = nullptr;
+        }
+    }
+    compiled.guard = {guard, ExprCompiler::compile(guard, variableSlots, outputSlots)};
+
+    // Delay is either number of milliseconds or name of a variable
+    if (CodeExecutor::isNumber(expr.delay)) {
+        compiled.delayMs = stoi(expr.delay);
+    }
+    else if (expr.delay != "") {
+        auto constantIt = constantVariables.find(expr.delay);
+        compiled.delaySlot = variableSlots.find(expr.delay);
+        if (compiled.delaySlot == -1) {
+            cout << "Variable \"" << expr.delay << "\" for delay does not exist in machine" << endl;
+        }
+        else if (constantIt != constantVariables.end() && constantIt->second.isNumeric()) {
+            compiled.delayMs = constantIt->second.asInt();
+            compiled.delaySlot = -1;
+        }
+    }
+    return compiled;
+}
+
+void MooreMachine::compileAll() {
+    takeStates();
+    vector<AstPtr> actions;
+    unordered_set<string> assigned;
+    for (const auto& state : states) {
+        actions.push_back(ExprParser::parseAction(state.outputExpr));
+        ExprOptimizer::collectAssigned(actions.back(), assigned);
+    }
+
+    // Variables no action writes to keep their initial value forever
+    constantVariables.clear();
+    for (const auto& var : variables) {
+        if (!assigned.count(var.name)) {
+            constantVariables.emplace(var.name, var.value);
+        }
+    }
+
+    // Declared outputs come first in the output row, in their declared order
+    for (const auto& output : outputs) {
+        outputSlots.intern(output);
+    }
+
+    for (size_t i = 0; i < states.size(); i++) {
+        compileState(states[i], actions[i]);
+    }
+}
+
 string MooreMachine::removeSpaces(string str) {
     str.erase(remove(str.begin(), str.end(), ' '), str.end());
     return str;
@@ -114,12 +348,23 @@ string MooreMachine::trimBracketSpaces(string str) {
 
 MooreMachine::MooreMachine() = default;
 
+MooreMachine::~MooreMachine() {
+    timers.reset();
+}
+
 int MooreMachine::addStartState(string name, string outputExpr, const unordered_map<TransitionExpression, int>& transitions) {
+    takeStates();
+
     //If no start state is assigned add start state and return index
     if (startState == -1) {
         int stateIndex = states.size();
-        states.push_back(State{name, outputExpr, transitions});
-        startState = currentState = stateIndex;
+        State state;
+        state.name = name;
+        state.outputExpr = outputExpr;
+        state.transitions = transitions;
+        states.push_back(move(state));
+        compileNewState(states.back());
+        startState = stateIndex;
         return stateIndex;
     }
 
@@ -131,13 +376,22 @@ int MooreMachine::addStartState(string name, string outputExpr, const unordered_
 }
 
 int MooreMachine::addState(string name, string outputExpr, const unordered_map<TransitionExpression, int>& transitions) {
-    states.push_back(State{name, outputExpr, transitions});
+    takeStates();
+    State state;
+    state.name = name;
+    state.outputExpr = outputExpr;
+    state.transitions = transitions;
+    states.push_back(move(state));
+    compileNewState(states.back());
     // Returns index in an array
     return states.size() - 1;
 }
 
 void MooreMachine::addTransition(int fromState, const string& expr, int toState) {
-    states[fromState].transitions[parseExpr(expr)] = toState;
+    TransitionExpression parsedExpr = parseExpr(expr);
+    takeStates();
+    states[fromState].transitions[parsedExpr] = toState;
+    compileTransitions(states[fromState]);
 }
 
 
@@ -147,17 +401,22 @@ void MooreMachine::addVariable(const string& type, const string& name, const str
         cout << "Invalid type: " << type << endl;
         return;
     }
-    for (const auto& var : variables) {
-        if (var.name == name) {
-            cout << "Variable \"" << name << "\" already defined." << endl;
-            return;
-        }
+    if (variableSlots.find(name) != -1) {
+        cout << "Variable \"" << name << "\" already defined." << endl;
+        return;
     }
 
-    variables.push_back({type, name, value});
+    takeStates();
+    variableSlots.intern(name);
+    variables.push_back({type, name, Value::parse(type, value)});
+
+    // Names in already compiled expressions may now refer to this variable
+    compileAll();
 }
 
 void MooreMachine::addInputs() {
+    takeStates();
+
     // Loop through all states
     for (const auto& state : states) {
         // Loop through each transition of the current state
@@ -173,6 +432,8 @@ void MooreMachine::addInputs() {
 }
 
 void MooreMachine::addOutputs() {
+    takeStates();
+
     // Loop through all states
     for (const auto& state : states) {
         string outputExpr = state.outputExpr;
@@ -212,90 +473,155 @@ void MooreMachine::addMachineDescription(const string& machineDescription) {
     this->machineDescription = machineDescription;
 }
 
-void MooreMachine::setCurrentOutput(const string& outputName, const string& outputValue) {
-    currentOutput[outputName] = outputValue;
+void MooreMachine::setCurrentOutput(const string& outputName, string_view outputValue) {
+    syncInstance();
+    instance.setCurrentOutput(outputName, outputValue);
 }
 
 void MooreMachine::setInitialOutput() {
-    for (const auto& output : outputs) {
-        setCurrentOutput(output, "");
-    }
+    syncInstance();
+    instance.resetOutputs();
 }
 
 void MooreMachine::processStartState() {
-    CodeExecutor executor(*this, states[currentState].outputExpr, "", "", "");
-    executor.executeStateExpr(states[currentState].outputExpr);
+    syncInstance();
+    instance.start();
+
+    // Machine starts over, so does the history of its outputs
+    if (recording.load(memory_order_relaxed)) {
+        lock_guard<mutex> lock(mtx);
+        if (outputHistory.getCapacity() > 0) {
+            outputHistory.reset(outputHistory.getCapacity(), instance.getOutputs());
+        }
+    }
 }
 
 // TODO: handle only bool expr
 void MooreMachine::processInput(const string& inputName, const string& inputValue) {
     if(isInputValid(inputName)) {
+        syncInstance();
+        int inputId = definition->inputSlots.find(inputName);
+        step(inputId, inputName, inputValue);
+        recordEvent(Trace::Kind::Input, inputId, inputValue);
+    }
 
-        setInitialOutput();
-
-        // Get all the transitions for current state
-        unordered_map<TransitionExpression, int> stateTransitions = getTransitions(states[currentState]);
-
-        // Find if we can do transition to next state
-        for (const auto& [expr, nextStateId] : stateTransitions) {
-
-            // Transition contains input we chose
-            if (expr.inputEvent == inputName) {
-
-                // Start new executor
-                CodeExecutor executor(*this, states[currentState].outputExpr, expr.boolExpr, inputName, inputValue);
-
-                // BoolExpr in [] is existing so we have to handle it
-                if (expr.boolExpr != "") {
-                    // Returns bool to know if we can do the transition
-                    bool transitionByBool = executor.executeTransitionBoolExpr();
-                    // If the transition is possible we move to the next state and do the next state action
-                    if (transitionByBool) {
-                        // Check if there is delay active for the current state, if so then interrupt delay because we can transition to next state
-                        if (delayActive) {
-                            interruptDelay();
-                        }
-                        currentState = nextStateId;
-                        if(expr.delay != "" && getDelayValue(expr.delay) != -1) {
-                            this_thread::sleep_for(chrono::milliseconds(getDelayValue(expr.delay)));
-                        }
-                        executor.executeStateExpr(states[currentState].outputExpr);
-
-                        // Get transitions of the state we moved into
-                        unordered_map<TransitionExpression, int> transferredToStateTransitions = getTransitions(states[currentState]);
-
-                        // Find if there is any state that has only delay defined
-                        for (const auto& [exprTransferred, nextStateIdTransferred] : transferredToStateTransitions) {
-                            if (exprTransferred.boolExpr == "" && exprTransferred.inputEvent == "" && exprTransferred.delay != "") {
-                                handleDelay(exprTransferred.delay, nextStateIdTransferred);
-                            }
-                        }
-                    }
-                }
-                else {
-                    // If we moved to the state after delay was fulfilled then we check if the state doesn't have only delay again
-                    if (expr.boolExpr == "" && expr.inputEvent == "" && expr.delay != "" && inputName == "" && inputValue == "") {
-                        handleDelay(expr.delay, nextStateId);
-                    }
+    else {
+        cout << "Input " << "\"" + inputName + "\" " << "is not valid" << endl;
+    }
+}
 
-                    else if (expr.boolExpr == "" && expr.inputEvent != "") {
-                        currentState = nextStateId;
-                        if(expr.delay != "" && getDelayValue(expr.delay) != -1) {
-                            this_thread::sleep_for(chrono::milliseconds(getDelayValue(expr.delay)));
-                        }
-                        executor.executeStateExpr(states[currentState].outputExpr);
-                    }
+future<int> MooreMachine::processInputAsync(const string& inputName, const string& inputValue) {
+    auto completion = make_shared<promise<int>>();
+    future<int> result = completion->get_future();
+    if (isInputValid(inputName)) {
+        syncInstance();
+        int inputId = definition->inputSlots.find(inputName);
+        step(inputId, inputName, inputValue, completion);
+        recordEvent(Trace::Kind::Input, inputId, inputValue);
+    }
+    else {
+        cout << "Input " << "\"" + inputName + "\" " << "is not valid" << endl;
+        completion->set_value(instance.getCurrentState());
+    }
+    return result;
+}
 
-                    else {
-                        cout << "Not implemented" << endl;
-                    }
-                }
+void MooreMachine::step(int inputId, const string& inputName, const string& inputValue, const shared_ptr<promise<int>>& completion) {
+    instance.resetOutputs();
+
+    // One executor serves all the guards and the action of this event
+    CodeExecutor executor(instance, inputName, inputValue);
+
+    // Find if we can do transition to next state
+    const CompiledTransition* transition = instance.selectTransition(executor, inputId, inputValue);
+    if (transition) {
+        // Check if there is delay active for the current state, if so then interrupt delay because we can transition to next state
+        if (transition->hasGuard && delayActive) {
+            interruptDelay();
+        }
+        // Target of delayed transition is entered by the timer, the caller does not wait
+        int delay = instance.view().getDelayValue(*transition);
+        if(delay != -1) {
+            PendingDelay pending;
+            pending.completion = completion;
+            pending.nextState = transition->nextState;
+            pending.withInput = true;
+            pending.guarded = transition->hasGuard;
+            pending.inputName = inputName;
+            pending.inputValue = inputValue;
+            addDelay(delay, move(pending));
+            return;
+        }
+
+        instance.setCurrentState(transition->nextState);
+        instance.enterState(transition->nextState, executor);
+
+        // Find if there is any transition of the state we moved into that has only delay defined
+        if (transition->hasGuard) {
+            startDelayedTransitions();
+        }
+    }
+
+    // If we moved to the state after delay was fulfilled then we check if the state doesn't have only delay again
+    else if (inputName == "" && inputValue == "") {
+        startDelayedTransitions();
+    }
+
+    if (completion) {
+        completion->set_value(instance.getCurrentState());
+    }
+}
+
+int MooreMachine::findInput(const string& inputName) {
+    if (!isInputValid(inputName)) {
+        return -1;
+    }
+    return getDefinition()->inputSlots.find(inputName);
+}
+
+EventBatchResult MooreMachine::processInputs(const InputEvent* events, size_t count) {
+    EventBatchResult result;
+    result.states.reserve(count);
+    syncInstance();
+    const MachineDefinition& current = *definition;
+
+    // Outputs after the previous event, changes are reported against them
+    vector<string> previous = instance.getOutputs();
+    int startedIn = instance.getCurrentState();
+
+    for (size_t i = 0; i < count; i++) {
+        const InputEvent& event = events[i];
+        if (event.inputId < 0 || event.inputId >= current.inputSlots.size()) {
+            cout << "Input id " << event.inputId << " is not valid" << endl;
+            result.states.push_back(instance.getCurrentState());
+            continue;
+        }
+
+        step(event.inputId, current.inputSlots.name(event.inputId), event.value);
+        recordEvent(Trace::Kind::Input, event.inputId, event.value);
+        result.states.push_back(instance.getCurrentState());
+
+        const vector<string>& outputs = instance.getOutputs();
+        for (size_t slot = 0; slot < outputs.size(); slot++) {
+            if (outputs[slot] != previous[slot]) {
+                result.changes.push_back({static_cast<int>(i), static_cast<int>(slot), outputs[slot]});
+                previous[slot] = outputs[slot];
             }
         }
     }
 
-    else {
-        cout << "Input " << "\"" + inputName + "\" " << "is not valid" << endl;
+    // GUI is told about the state the batch ended in, not about every step
+    if (autoTransition && instance.getCurrentState() != startedIn) {
+        autoTransition(instance.getCurrentState());
+    }
+    return result;
+}
+
+void MooreMachine::startDelayedTransitions() {
+    int nextState;
+    int delay = instance.view().getEntryDelay(nextState);
+    if (delay != -1) {
+        handleDelay(delay, nextState);
     }
 }
 
@@ -313,7 +639,7 @@ bool MooreMachine::isInputValid(const string& inputName) {
     return false;
 }
 
-unordered_map<TransitionExpression, int> MooreMachine::getTransitions(State& currentState) {
+const unordered_map<TransitionExpression, int>& MooreMachine::getTransitions(const State& currentState) {
     return currentState.transitions;
 }
 
@@ -325,117 +651,368 @@ vector<string> MooreMachine::getInputs() {
     return inputs;
 }
 
-bool MooreMachine::delayValid(const string& delayValue) {
-    // We resolve delay value
-    // Check if it is a number
-    if (CodeExecutor::isNumber(delayValue)) {
-        return true;;
-    }
+void MooreMachine::handleDelay(int delay, int nextState) {
+    PendingDelay pending;
+    pending.nextState = nextState;
+    addDelay(delay, move(pending));
+}
 
-    // Check if it is valid variable
+void MooreMachine::addDelay(int delay, PendingDelay pending) {
+    // Callback gets its own copy of the transition, the entry is gone by the time it runs
+    function<void()> callback;
+    if (pending.withInput) {
+        callback = [this, nextState = pending.nextState, guarded = pending.guarded, inputName = pending.inputName, inputValue = pending.inputValue] {
+            finishDelayedTransition(nextState, guarded, inputName, inputValue);
+        };
+    }
     else {
-        for (const auto& var : variables) {
-            if (var.name == delayValue && CodeExecutor::isNumber(var.value)) {
-                return true;
-            }
-            else {
-                cout << "Variable \"" << delayValue << "\" for delay does not exist in machine or value of the variable is not a number" << endl;
-                return false;
-            }
+        callback = [this, nextState = pending.nextState] {
+            finishDelay(nextState);
+        };
+    }
+
+    lock_guard<mutex> lock(mtx);
+    if (!timers) {
+        timers = make_unique<TimerWheel>(clock);
+        if (timerThread) {
+            timers->start();
         }
     }
 
-    return false;
+    delayActive = true;
+    pending.due = clock->now() + chrono::milliseconds(delay);
+    pending.timer = timers->schedule(chrono::milliseconds(delay), move(callback));
+    delayTimers.push_back(move(pending));
 }
 
-int MooreMachine::getDelayValue(const string& delayValue) {
-    if (delayValid(delayValue)) {
-        // Number
-        if (CodeExecutor::isNumber(delayValue)) {
-            return stoi(delayValue);;
-        }
+void MooreMachine::recordEvent(Trace::Kind kind, int inputId, const string& inputValue) {
+    if (!recording.load(memory_order_relaxed)) {
+        return;
+    }
 
-        // Variable
-        else {
-            for (const auto& var : variables) {
-                if (var.name == delayValue && CodeExecutor::isNumber(var.value)) {
-                    return stoi(var.value);
-                }
-            }
+    // Timer thread records too, so the recorders are used under the lock
+    lock_guard<mutex> lock(mtx);
+    outputHistory.record(instance.getOutputs());
+    if (trace) {
+        trace->record(kind, inputId, inputValue, instance.getCurrentState(), instance.getOutputs(), clock->now());
+    }
+}
+
+vector<shared_ptr<promise<int>>> MooreMachine::takeDelays() {
+    vector<shared_ptr<promise<int>>> completions;
+    lock_guard<mutex> lock(mtx);
+
+    // Machine leaves the state, other delays of it can not fire anymore
+    for (const PendingDelay& delay : delayTimers) {
+        timers->cancel(delay.timer);
+        if (delay.completion) {
+            completions.push_back(delay.completion);
         }
     }
+    delayTimers.clear();
+    delayActive = false;
+    return completions;
+}
+
+void MooreMachine::finishDelay(int nextState) {
+    vector<shared_ptr<promise<int>>> completions = takeDelays();
 
-    return -1;
+    // Delay was fulfilled
+    cout << "Delay finished normally" << endl;
+    syncInstance();
+    instance.setCurrentState(nextState);
+    step(definition->inputSlots.find(""), "", "");
+    recordEvent(Trace::Kind::Timer, -1, "");
+    delayFinished(completions);
 }
 
-void MooreMachine::handleDelay(const string& delayValue, int nextState) {
-    int delay;
+void MooreMachine::finishDelayedTransition(int nextState, bool guarded, const string& inputName, const string& inputValue) {
+    vector<shared_ptr<promise<int>>> completions = takeDelays();
+    syncInstance();
 
-    // We resolve delay value
-    // Check if it is a number
-    if (CodeExecutor::isNumber(delayValue)) {
-        delay = stoi(delayValue);
+    // Action of the target sees the input that took the transition, outputs of that event are gone
+    instance.resetOutputs();
+    CodeExecutor executor(instance, inputName, inputValue);
+    instance.enterState(nextState, executor);
+    if (guarded) {
+        startDelayedTransitions();
     }
+    recordEvent(Trace::Kind::Timer, -1, "");
+    delayFinished(completions);
+}
 
-    // Check if it is valid variable
-    // Loop all variables
-    else {
-        bool found = false;
-        for (const auto& var : variables) {
-            if (var.name == delayValue && CodeExecutor::isNumber(var.value)) {
-                delay = stoi(var.value);
-                found = true;
-                break;
-            }
+void MooreMachine::delayFinished(const vector<shared_ptr<promise<int>>>& completions) {
+    for (const auto& completion : completions) {
+        completion->set_value(instance.getCurrentState());
+    }
+
+    // handle delay in gui
+    if (autoTransition) {
+        autoTransition(instance.getCurrentState());
+    }
+}
+
+string MooreMachine::saveSnapshot() {
+    syncInstance();
+    string data;
+    SnapshotWriter writer(data);
+    writer.header(Snapshot::Kind::Machine, *definition);
+    instance.writeState(writer);
+
+    // Delays are saved with the time they have left, completions stay with this process
+    lock_guard<mutex> lock(mtx);
+    Clock::TimePoint now = clock->now();
+    writer.u32(static_cast<uint32_t>(delayTimers.size()));
+    for (const PendingDelay& delay : delayTimers) {
+        writer.i32(static_cast<int>(max<long long>(0, chrono::duration_cast<chrono::milliseconds>(delay.due - now).count())));
+        writer.i32(delay.nextState);
+        writer.u8((delay.withInput ? 1 : 0) | (delay.guarded ? 2 : 0));
+        if (delay.withInput) {
+            writer.text(delay.inputName);
+            writer.text(delay.inputValue);
         }
-        if (!found)
-        {
-            cout << "Variable \"" << delayValue << "\" for delay does not exist in machine or value of the variable is not a number" << endl;
-            return;
+    }
+    return data;
+}
+
+bool MooreMachine::restoreSnapshot(string_view data) {
+    syncInstance();
+    SnapshotReader reader(data);
+    if (!reader.header(Snapshot::Kind::Machine, *definition)) {
+        return false;
+    }
+
+    // Instance is restored into a copy, so the simulation stays as it was if anything is wrong
+    MachineInstance restored(definition);
+    restored.setClock(clock);
+    if (!restored.readState(reader)) {
+        return false;
+    }
+
+    uint32_t delayCount = reader.u32();
+    if (!reader.ok() || delayCount > data.size()) {
+        cout << "Snapshot is damaged" << endl;
+        return false;
+    }
+    vector<pair<int, PendingDelay>> delays(delayCount);
+    for (auto& [remaining, delay] : delays) {
+        remaining = reader.i32();
+        delay.nextState = reader.i32();
+        uint8_t flags = reader.u8();
+        delay.withInput = flags & 1;
+        delay.guarded = flags & 2;
+        if (delay.withInput) {
+            reader.text(delay.inputName);
+            reader.text(delay.inputValue);
         }
+        if (delay.nextState < 0 || delay.nextState >= static_cast<int>(definition->states.size())) {
+            cout << "Snapshot is damaged" << endl;
+            return false;
+        }
+    }
+    if (!reader.ok()) {
+        cout << "Snapshot is damaged" << endl;
+        return false;
     }
 
-    // Create thread for the state
-    thread([this, delay, nextState] () {
-        unique_lock<mutex> lock(mtx);
-        delayActive = true;
-        bool timedOut = !cv.wait_for(lock, chrono::milliseconds(delay), [this] {
-            return delayCancel;
-        });
+    // Delays of the simulation being replaced do not fire, their callers learn where it stood
+    vector<shared_ptr<promise<int>>> completions = takeDelays();
+    for (const auto& completion : completions) {
+        completion->set_value(instance.getCurrentState());
+    }
 
-        // Delay was fulfilled
-        if(timedOut) {
-            cout << "Delay finished normally" << endl;
-            delayActive = false;
-            delayCancel = false;
-            currentState = nextState;
-            processInput("", "");
+    instance = move(restored);
+    for (auto& [remaining, delay] : delays) {
+        addDelay(remaining, move(delay));
+    }
+    if (autoTransition) {
+        autoTransition(instance.getCurrentState());
+    }
+    return true;
+}
+
+void MooreMachine::setTimerThread(bool enabled) {
+    TimerWheel* wheel;
+    {
+        lock_guard<mutex> lock(mtx);
+        timerThread = enabled;
+        wheel = timers.get();
+    }
 
-            // handle delay in gui
-            if (autoTransition) {
-                autoTransition(currentState);
+    // Stopping joins the timer thread, whose callbacks take the lock
+    if (!wheel) {
+        return;
+    }
+    if (enabled) {
+        wheel->start();
+    }
+    else {
+        wheel->stop();
+    }
+}
+
+int MooreMachine::pollTimers() {
+    // Only the owner of the machine creates the timers, so reading the pointer needs no lock
+    if (!timers) {
+        return 0;
+    }
+    return timers->poll();
+}
+
+Clock::TimePoint MooreMachine::nextTimerDue() const {
+    if (!timers) {
+        return Clock::TimePoint::max();
+    }
+    return timers->nextDue();
+}
+
+bool MooreMachine::startTrace(const string& filename) {
+    syncInstance();
+    auto recorder = make_unique<TraceRecorder>();
+    if (!recorder->open(filename, saveSnapshot(), instance.getOutputs(), clock->now())) {
+        return false;
+    }
+
+    {
+        lock_guard<mutex> lock(mtx);
+        swap(trace, recorder);
+        recording = true;
+    }
+
+    // Previous trace is written out without holding the lock
+    recorder.reset();
+    return true;
+}
+
+void MooreMachine::stopTrace() {
+    unique_ptr<TraceRecorder> recorder;
+    {
+        lock_guard<mutex> lock(mtx);
+        swap(trace, recorder);
+        recording = outputHistory.getCapacity() > 0;
+    }
+    recorder.reset();
+}
+
+bool MooreMachine::replayTrace(const string& filename, TraceReplayResult& result) {
+    result = TraceReplayResult();
+    TraceReader reader;
+    if (!reader.open(filename)) {
+        return false;
+    }
+
+    // Delays of the replay fire only when the loop below polls them
+    auto virtualClock = make_shared<VirtualClock>();
+    setTimerThread(false);
+    setClock(virtualClock);
+    if (!restoreSnapshot(reader.getSnapshot())) {
+        return false;
+    }
+
+    // GUI learns only where the replay ended
+    function<void(int)> callback = move(autoTransition);
+    autoTransition = nullptr;
+
+    const MachineDefinition& current = *definition;
+    Clock::TimePoint start = virtualClock->now();
+    vector<string> expected = instance.getOutputs();
+    TraceRecord record;
+    while (reader.next(record)) {
+        // Inputs arrive at their recorded times, delays end at the records they produced
+        virtualClock->advanceTo(start + chrono::microseconds(record.time));
+        if (record.kind == Trace::Kind::Input) {
+            if (record.inputId >= 0 && record.inputId < current.inputSlots.size()) {
+                step(record.inputId, current.inputSlots.name(record.inputId), record.value);
+                recordEvent(Trace::Kind::Input, record.inputId, record.value);
             }
         }
-
-        // Delay was interrupted
         else {
-            cout << "Delay interrupted" << endl;
-            delayActive = false;
-            delayCancel = false;
+            pollTimers();
+        }
+
+        bool matches = instance.getCurrentState() == record.state;
+        for (const OutputChange& change : record.changes) {
+            if (change.slot >= 0 && change.slot < static_cast<int>(expected.size())) {
+                expected[change.slot] = change.value;
+            }
+            else {
+                matches = false;
+            }
+        }
+        if (!matches || instance.getOutputs() != expected) {
+            if (result.mismatches == 0) {
+                result.firstMismatch = static_cast<long long>(result.events);
+            }
+            result.mismatches++;
         }
-    }).detach();
+        result.events++;
+    }
+
+    autoTransition = move(callback);
+    if (autoTransition) {
+        autoTransition(instance.getCurrentState());
+    }
+    return reader.finished();
+}
+
+void MooreMachine::setOutputHistory(size_t capacity) {
+    syncInstance();
+    lock_guard<mutex> lock(mtx);
+    outputHistory.reset(capacity, instance.getOutputs());
+    recording = trace || capacity > 0;
+}
+
+uint64_t MooreMachine::getHistoryStep() {
+    lock_guard<mutex> lock(mtx);
+    return outputHistory.getStep();
+}
+
+bool MooreMachine::getOutputAt(const string& outputName, uint64_t step, string& value) {
+    int slot = getDefinition()->outputSlots.find(outputName);
+    if (slot == -1) {
+        return false;
+    }
+    lock_guard<mutex> lock(mtx);
+    return outputHistory.valueAt(slot, step, value);
+}
+
+vector<OutputSample> MooreMachine::getOutputChanges(const string& outputName, uint64_t from, uint64_t to) {
+    int slot = getDefinition()->outputSlots.find(outputName);
+    if (slot == -1) {
+        return {};
+    }
+    lock_guard<mutex> lock(mtx);
+    return outputHistory.changes(slot, from, to);
 }
 
 void MooreMachine::interruptDelay() {
+    bool interrupted = false;
+    vector<shared_ptr<promise<int>>> completions;
     {
         lock_guard<mutex> lock(mtx);
-        delayCancel = true;
+        for (const PendingDelay& delay : delayTimers) {
+            interrupted = timers->cancel(delay.timer) || interrupted;
+            if (delay.completion) {
+                completions.push_back(delay.completion);
+            }
+        }
+        delayTimers.clear();
+        delayActive = false;
     }
 
-    cv.notify_all();
+    // Delay was interrupted
+    if (interrupted) {
+        cout << "Delay interrupted" << endl;
+    }
+
+    // Callers waiting for the delayed transition learn the machine stayed where it is
+    for (const auto& completion : completions) {
+        completion->set_value(instance.getCurrentState());
+    }
 }
 
 void MooreMachine::checkReachability() {
+    const vector<State>& states = currentStates();
     unordered_set<int> visited;
     dfs(0, visited); // Start from state 0
 
@@ -448,6 +1025,7 @@ void MooreMachine::checkReachability() {
 }
 
 void MooreMachine::checkDeadStates() {
+    const vector<State>& states = currentStates();
     for (size_t i = 0; i < states.size(); ++i) {
         if (states[i].transitions.empty()) {
             cout << "State \"" << states[i].name << "\" is a dead state, can't go anywhere from it" << endl;
@@ -456,6 +1034,7 @@ void MooreMachine::checkDeadStates() {
 }
 
 void MooreMachine::checkRedundancy() {
+    const vector<State>& states = currentStates();
     for (size_t i = 0; i < states.size(); ++i) {
         for (size_t j = i + 1; j < states.size(); ++j) {
             if (states[i].outputExpr == states[j].outputExpr &&
@@ -497,10 +1076,11 @@ void MooreMachine::printMachine() {
     // Print variables in machine
     cout << "Variables:\n";
     for (const auto& var : variables) {
-        cout << "   " << var.type << " " << var.name << " = " << var.value << "\n";
+        cout << "   " << var.type << " " << var.name << " = " << var.value.toString() << "\n";
     }
 
     // Print all the states with their index, output and all transitions
+    const vector<State>& states = currentStates();
     cout << "States:\n";
     for (size_t i = 0; i < states.size(); ++i) {
         cout << "   " << states[i].name << ": " << states[i].outputExpr << "\n";
@@ -518,12 +1098,13 @@ void MooreMachine::printMachine() {
     }
 
     // Print current state, at the start should be same as startState
-    cout << "Current State:\n" << "   " << currentState << "\n";
+    cout << "Current State:\n" << "   " << getCurrentState() << "\n";
 
     // Print current state, at the start should be same as startState
     cout << "Current Outputs:" << endl;
-    for (const auto& output : currentOutput) {
-        cout << "   " << output.first << ": " << output.second << endl;
+    const vector<string>& currentOutput = getInstance().getOutputs();
+    for (size_t i = 0; i < currentOutput.size(); i++) {
+        cout << "   " << instance.getDefinition()->outputSlots.name(i) << ": " << currentOutput[i] << endl;
     }
 
     // Print start state
@@ -539,195 +1120,341 @@ void MooreMachine::printMachine() {
 }
 
 void MooreMachine::createJSONFile(const string& name) {
-    nlohmann::ordered_json jsonFile;
-    jsonFile["name"] = machineName;
-    jsonFile["description"] = machineDescription;
-    jsonFile["inputs"] = inputs;
-    jsonFile["outputs"] = outputs;
-
-    vector<nlohmann::ordered_json> varsJson;
-    for (const auto& var : variables) {
-        varsJson.push_back(varToJSON(var));
-    }
-    jsonFile["variables"] = varsJson;
-
-    std::vector<nlohmann::ordered_json> statesJson;
-    for (const auto& state : states) {
-        statesJson.push_back(stateToJSON(state, true));
-    }
-    jsonFile["states"] = statesJson;
-
-    std::vector<nlohmann::ordered_json> transitionsJson;
-    for (const auto& state : states) {
-        transitionsJson.push_back(stateToJSON(state, false));
-    }
-    jsonFile["transitions"] = transitionsJson;
-
     ofstream file(name + ".json");
-    file << jsonFile.dump(4);
+    writeJson(file);
     file.close();
 }
 
-nlohmann::ordered_json MooreMachine::varToJSON(const Variable& var) {
-    return nlohmann::ordered_json{
-        {"type", var.type},
-        {"name", var.name},
-        {"value", var.value}
-    };
-}
-
-nlohmann::ordered_json MooreMachine::transitionExprToJSON(const TransitionExpression& expr) {
-    return nlohmann::ordered_json{
-        {"inputEvent", expr.inputEvent},
-        {"boolExpr", expr.boolExpr},
-        {"delay", expr.delay}
-    };
+void MooreMachine::writeJson(ostream& out) {
+    MachineJsonWriter writer(out);
+    serialize(writer);
 }
 
-nlohmann::ordered_json MooreMachine::stateToJSON(const State& state, bool onlyStates) {
-    nlohmann::ordered_json j;
-    j["name"] = state.name;
-    if (onlyStates) {
-        j["outputExpr"] = state.outputExpr;
-        return j;
+void MooreMachine::serialize(MachineVisitor& visitor) {
+    const vector<State>& states = currentStates();
+    visitor.machine(machineName, machineDescription, inputs, outputs);
+    for (const auto& var : variables) {
+        visitor.variable(var);
     }
-
-    else {
-        // Transitions array
-        std::vector<nlohmann::ordered_json> transitionsJson;
+    for (const auto& state : states) {
+        visitor.state(state);
+    }
+    for (const auto& state : states) {
+        visitor.transitions(state);
         for (const auto& [expr, nextState] : state.transitions) {
-            transitionsJson.push_back({
-                {"expression", transitionExprToJSON(expr)},
-                {"nextState", states[nextState].name}
-            });
+            visitor.transition(expr, states[nextState].name);
         }
-        j["transitions"] = transitionsJson;
-        return j;
     }
-}
-
-Variable MooreMachine::jsonToVariable(const nlohmann::ordered_json& j) {
-    return {
-        j.at("type").get<string>(),
-        j.at("name").get<string>(),
-        j.at("value").get<string>()
-    };
+    visitor.end();
 }
 
 void MooreMachine::loadFromJSONFile(const string& filename) {
-    ifstream file(filename);
+    ifstream file(filename, ios::binary);
     // Check if file exists/can be opened
     if (!file.is_open()) {
         cout << "Failed to open file: " << filename << endl;
         return;
     }
 
-    nlohmann::ordered_json jsonFile;
-    file >> jsonFile;
+    // Machine is streamed into the reader, the JSON text is never held as a whole
+    MachineJsonReader reader;
+    if (!reader.read(file)) {
+        return;
+    }
+
+    // Loaded states are added to the ones the machine has
+    takeStates();
 
     // Load name and description
-    machineName = jsonFile.at("name").get<string>();
-    machineDescription = jsonFile.at("description").get<string>();
+    machineName = move(reader.name);
+    machineDescription = move(reader.description);
 
     // Load inputs
-    inputs = jsonFile.at("inputs").get<vector<string>>();
+    inputs = move(reader.inputs);
 
     // Load outputs
-    outputs = jsonFile.at("outputs").get<vector<string>>();
+    outputs = move(reader.outputs);
 
     // Load variables
     variables.clear();
-    for (const auto& varJson : jsonFile.at("variables")) {
-        variables.push_back(jsonToVariable(varJson));
+    variableSlots.clear();
+    for (auto& var : reader.variables) {
+        if (variableSlots.find(var.name) != -1) {
+            cout << "Variable \"" << var.name << "\" already defined." << endl;
+            continue;
+        }
+        variableSlots.intern(var.name);
+        variables.push_back(move(var));
     }
 
-    // Load states
-    for (const auto& stateJson : jsonFile.at("states")) {
+    // Load states, names are resolved through the index, first state of the name wins
+    unordered_map<string, int> stateIndex;
+    stateIndex.reserve(states.size() + reader.states.size());
+    for (size_t i = 0; i < states.size(); i++) {
+        stateIndex.emplace(states[i].name, static_cast<int>(i));
+    }
+    states.reserve(states.size() + reader.states.size());
+    for (auto& entry : reader.states) {
         State state;
-        state.name = stateJson.at("name").get<string>();
-        state.outputExpr = stateJson.at("outputExpr").get<string>();
-        states.push_back(state);
+        state.name = move(entry.name);
+        state.outputExpr = move(entry.outputExpr);
+        stateIndex.emplace(state.name, static_cast<int>(states.size()));
+        states.push_back(move(state));
     }
 
     // Load transitions for states
-    for (const auto& transBlock : jsonFile.at("transitions")) {
-        string stateName = transBlock.at("name").get<string>();
-
-        // Find the corresponding state by name
-        auto it = find_if(states.begin(), states.end(), [&](const State& s) {
-            return s.name == stateName;
-        });
-
-        // If state exists get all its transitions
-        if (it != states.end()) {
-            for (const auto& transition : transBlock.at("transitions")) {
-                TransitionExpression expr;
-                auto exprJson = transition.at("expression");
-                expr.inputEvent = exprJson.at("inputEvent").get<string>();
-                expr.boolExpr = exprJson.at("boolExpr").get<string>();
-                expr.delay = exprJson.at("delay").get<string>();
-
-                string nextStateName = transition.at("nextState").get<string>();
-
-                // Find next state's index
-                auto nextIt = find_if(states.begin(), states.end(), [&](const State& s) {
-                    return s.name == nextStateName;
-                });
-
-                // If next state exists then get its index
-                if (nextIt != states.end()) {
-                    // Compute the index of found state
-                    int nextIndex = distance(states.begin(), nextIt);
-                    it->transitions[expr] = nextIndex;
-                } else {
-                    cout << "Next state not found: " << nextStateName << endl;
-                }
+    for (const auto& block : reader.blocks) {
+        auto from = stateIndex.find(block.name);
+        if (from == stateIndex.end()) {
+            cout << "State not found for transitions: " << block.name << endl;
+            continue;
+        }
+
+        State& state = states[from->second];
+        for (size_t i = block.first; i < block.first + block.count; i++) {
+            auto& transition = reader.transitions[i];
+            auto next = stateIndex.find(transition.nextState);
+            if (next == stateIndex.end()) {
+                cout << "Next state not found: " << transition.nextState << endl;
+                continue;
             }
-        } else {
-            cout << "State not found for transitions: " << stateName << endl;
+            state.transitions[move(transition.expr)] = next->second;
         }
     }
 
+    // Compile output expressions and guards
+    compileAll();
+
     // Set other initial attributes
-    currentState = 0;
     startState = 0;
+    takeStates();
+    instance = MachineInstance();
+    instance.setClock(clock);
     setInitialOutput();
 }
 
-// Get json file for codegen
-nlohmann::ordered_json MooreMachine::getJson()
-{
-    nlohmann::ordered_json jsonFile;
-    jsonFile["name"] = machineName;
-    jsonFile["description"] = machineDescription;
-    jsonFile["inputs"] = inputs;
-    jsonFile["outputs"] = outputs;
+bool MooreMachine::saveImage(const string& filename) {
+    shared_ptr<const MachineDefinition> current = getDefinition();
+    MachineImageBuilder builder;
+    ImageFormat::Header& header = builder.getHeader();
+    header.name = builder.addString(machineName);
+    header.description = builder.addString(machineDescription);
+    header.startState = startState;
+    header.inputs = builder.addStrings(inputs);
+    header.outputs = builder.addStrings(outputs);
+
+    vector<string> names;
+    for (int slot = 0; slot < variableSlots.size(); slot++) {
+        names.push_back(variableSlots.name(slot));
+    }
+    header.variableSlots = builder.addStrings(names);
+    names.clear();
+    for (int slot = 0; slot < inputSlots.size(); slot++) {
+        names.push_back(inputSlots.name(slot));
+    }
+    header.inputSlots = builder.addStrings(names);
+    names.clear();
+    for (int slot = 0; slot < outputSlots.size(); slot++) {
+        names.push_back(outputSlots.name(slot));
+    }
+    header.outputSlots = builder.addStrings(names);
 
-    vector<nlohmann::ordered_json> varsJson;
     for (const auto& var : variables) {
-        varsJson.push_back(varToJSON(var));
+        ImageFormat::VariableRecord record{};
+        record.type = builder.addString(var.type);
+        record.name = builder.addString(var.name);
+        record.value = builder.valueRecord(var.value);
+        record.constant = constantVariables.count(var.name) ? 1 : 0;
+        builder.addVariable(record);
     }
-    jsonFile["variables"] = varsJson;
 
-    std::vector<nlohmann::ordered_json> statesJson;
-    for (const auto& state : states) {
-        statesJson.push_back(stateToJSON(state, true));
+    // Rows and ids come from the definition, it has them complete
+    for (const auto& state : current->states) {
+        ImageFormat::StateRecord record{};
+        record.name = builder.addString(state.name);
+        record.outputExpr = builder.addString(state.outputExpr);
+        record.action = builder.addProgram(state.action.program);
+        record.constantAction = state.constantAction ? 1 : 0;
+        record.outputRow = builder.addStrings(state.outputRow);
+        record.inputRuns = builder.addIds(state.inputRuns);
+
+        vector<int> sources;
+        for (const auto& [expr, nextState] : state.transitions) {
+            sources.push_back(static_cast<int>(builder.addString(expr.inputEvent)));
+            sources.push_back(static_cast<int>(builder.addString(expr.boolExpr)));
+            sources.push_back(static_cast<int>(builder.addString(expr.delay)));
+            sources.push_back(nextState);
+        }
+        record.sources = builder.addIds(sources);
+
+        record.transitions.first = builder.transitionCount();
+        for (const auto& transition : state.compiled) {
+            ImageFormat::TransitionRecord compiled{};
+            compiled.nextState = transition.nextState;
+            compiled.flags = (transition.hasInput ? ImageFormat::TransitionHasInput : 0)
+                | (transition.hasGuard ? ImageFormat::TransitionHasGuard : 0)
+                | (transition.hasDelay ? ImageFormat::TransitionHasDelay : 0);
+            compiled.delayMs = transition.delayMs;
+            compiled.delaySlot = transition.delaySlot;
+            compiled.guard = builder.addProgram(transition.guard.program);
+            builder.addTransition(compiled);
+        }
+        record.transitions.count = builder.transitionCount() - record.transitions.first;
+        builder.addState(record);
     }
-    jsonFile["states"] = statesJson;
 
-    std::vector<nlohmann::ordered_json> transitionsJson;
-    for (const auto& state : states) {
-        transitionsJson.push_back(stateToJSON(state, false));
+    return builder.write(filename);
+}
+
+bool MooreMachine::loadFromImage(const string& filename) {
+    // Machine is replaced, callback of the GUI stays
+    function<void(int)> callback = move(autoTransition);
+    clear();
+    autoTransition = move(callback);
+
+    MachineImage image;
+    if (!image.open(filename)) {
+        return false;
+    }
+
+    // Any record pointing outside of the image makes the whole image unusable
+    auto damaged = [this, &filename] {
+        cout << "Machine image " << filename << " is damaged" << endl;
+        function<void(int)> callback = move(autoTransition);
+        clear();
+        autoTransition = move(callback);
+        return false;
+    };
+
+    const ImageFormat::Header& header = image.header();
+    const uint32_t* ids = image.records<uint32_t>(ImageFormat::Ids);
+    auto strings = [&](ImageFormat::Range range, vector<string>& out) {
+        if (!image.contains(ImageFormat::Ids, range)) {
+            return false;
+        }
+        out.clear();
+        out.reserve(range.count);
+        for (uint32_t i = 0; i < range.count; i++) {
+            out.emplace_back(image.text(ids[range.first + i]));
+        }
+        return true;
+    };
+    auto slots = [&](ImageFormat::Range range, SymbolTable& table) {
+        vector<string> names;
+        if (!strings(range, names)) {
+            return false;
+        }
+        for (const auto& name : names) {
+            table.intern(name);
+        }
+        return true;
+    };
+
+    machineName = image.text(header.name);
+    machineDescription = image.text(header.description);
+    if (!strings(header.inputs, inputs) || !strings(header.outputs, outputs) || !slots(header.variableSlots, variableSlots)
+        || !slots(header.inputSlots, inputSlots) || !slots(header.outputSlots, outputSlots)) {
+        return damaged();
+    }
+
+    uint32_t variableCount = image.count(ImageFormat::Variables);
+    const ImageFormat::VariableRecord* variableRecords = image.records<ImageFormat::VariableRecord>(ImageFormat::Variables);
+    for (uint32_t i = 0; i < variableCount; i++) {
+        Variable var{string(image.text(variableRecords[i].type)), string(image.text(variableRecords[i].name)), image.value(variableRecords[i].value)};
+        if (variableRecords[i].constant) {
+            constantVariables.emplace(var.name, var.value);
+        }
+        variables.push_back(move(var));
+    }
+
+    // Variable and output slots of the code have to exist, other operands were checked with the program
+    auto program = [&](uint32_t index, Program& out, int result) {
+        if (!image.program(index, out, result)) {
+            return false;
+        }
+        for (const Instruction& instruction : out.code) {
+            if ((instruction.op == OpCode::LoadVar || instruction.op == OpCode::StoreVar)
+                && (instruction.arg < 0 || instruction.arg >= static_cast<int>(variableCount))) {
+                return false;
+            }
+            if (instruction.op == OpCode::Output && (instruction.arg < 0 || instruction.arg >= outputSlots.size())) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    uint32_t stateCount = image.count(ImageFormat::States);
+    const ImageFormat::StateRecord* stateRecords = image.records<ImageFormat::StateRecord>(ImageFormat::States);
+    const ImageFormat::TransitionRecord* transitionRecords = image.records<ImageFormat::TransitionRecord>(ImageFormat::Transitions);
+    states.resize(stateCount);
+    for (uint32_t i = 0; i < stateCount; i++) {
+        const ImageFormat::StateRecord& record = stateRecords[i];
+        State& state = states[i];
+        state.name = image.text(record.name);
+        state.outputExpr = image.text(record.outputExpr);
+        state.constantAction = record.constantAction != 0;
+        if (!program(record.action, state.action.program, 0) || !strings(record.outputRow, state.outputRow)
+            || !image.contains(ImageFormat::Ids, record.inputRuns) || !image.contains(ImageFormat::Ids, record.sources)
+            || !image.contains(ImageFormat::Transitions, record.transitions) || record.sources.count % 4 != 0) {
+            return damaged();
+        }
+
+        state.inputRuns.assign(ids + record.inputRuns.first, ids + record.inputRuns.first + record.inputRuns.count);
+        for (int run : state.inputRuns) {
+            if (run < 0 || run > static_cast<int>(record.transitions.count)) {
+                return damaged();
+            }
+        }
+
+        // Inserted backwards, so the table iterates in the saved order again
+        for (uint32_t j = record.sources.count; j > 0; j -= 4) {
+            const uint32_t* source = ids + record.sources.first + j - 4;
+            TransitionExpression expr;
+            expr.inputEvent = image.text(source[0]);
+            expr.boolExpr = image.text(source[1]);
+            expr.delay = image.text(source[2]);
+            if (source[3] >= stateCount) {
+                return damaged();
+            }
+            state.transitions[expr] = static_cast<int>(source[3]);
+        }
+
+        state.compiled.resize(record.transitions.count);
+        for (uint32_t j = 0; j < record.transitions.count; j++) {
+            const ImageFormat::TransitionRecord& compiled = transitionRecords[record.transitions.first + j];
+            CompiledTransition& transition = state.compiled[j];
+            transition.nextState = compiled.nextState;
+            transition.hasInput = compiled.flags & ImageFormat::TransitionHasInput;
+            transition.hasGuard = compiled.flags & ImageFormat::TransitionHasGuard;
+            transition.hasDelay = compiled.flags & ImageFormat::TransitionHasDelay;
+            transition.delayMs = compiled.delayMs;
+            transition.delaySlot = compiled.delaySlot;
+            if (!program(compiled.guard, transition.guard.program, 1) || transition.nextState < 0 || transition.nextState >= static_cast<int>(stateCount)
+                || transition.delaySlot < -1 || transition.delaySlot >= static_cast<int>(variableCount)) {
+                return damaged();
+            }
+        }
+    }
+
+    // Slots referenced by the code have to exist
+    if (variableSlots.size() != static_cast<int>(variableCount) || header.startState < -1 || header.startState >= static_cast<int>(stateCount)) {
+        return damaged();
     }
-    jsonFile["transitions"] = transitionsJson;
 
-    return jsonFile;
+    startState = header.startState;
+    takeStates();
+    instance = MachineInstance();
+    instance.setClock(clock);
+    setInitialOutput();
+    return true;
 }
 
 // Getter for current state
 int MooreMachine::getCurrentState()
 {
-    return currentState;
+    syncInstance();
+    return instance.getCurrentState();
 }
 
 // Getter for allowed types
@@ -739,15 +1466,23 @@ vector<string> MooreMachine::getAllowedTypes()
 void MooreMachine::clear() {
     states.clear();
     variables.clear();
+    variableSlots.clear();
+    constantVariables.clear();
     inputs.clear();
+    inputSlots.clear();
     outputs.clear();
-    currentOutput.clear();
+    outputSlots.clear();
+    definition.reset();
+    instance = MachineInstance();
+    instance.setClock(clock);
     startState = -1;
-    currentState = -1;
     machineName.clear();
     machineDescription.clear();
     delayActive = false;
-    delayCancel = false;
     autoTransition = nullptr;
     interruptDelay();
+
+    // History of the outputs belongs to the machine that was cleared
+    lock_guard<mutex> lock(mtx);
+    outputHistory.reset(outputHistory.getCapacity(), {});
 }
@@ -8,20 +8,33 @@
 #define MOORE_MACHINE_H
 #pragma once
 
+#include <atomic>
 #include <iostream>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 #include <algorithm>
 #include <mutex>
-#include <condition_variable>
+#include <functional>
+#include <future>
+#include <chrono>
+#include <memory>
 
 /**
  * PREVZATE Z : https://github.com/nlohmann/json
  */
 #include "json.hpp"
+#include "Clock.h"
 #include "Structs.h"
+#include "SymbolTable.h"
+#include "TimerWheel.h"
+#include "MachineDefinition.h"
+#include "MachineInstance.h"
+#include "MachineVisitor.h"
+#include "OutputHistory.h"
+#include "Trace.h"
 
 class MooreMachine {
 private:
@@ -31,35 +44,47 @@ private:
     // Description of the machine
     std::string machineDescription;
 
-    // States for the machine
+    // States for the machine, moved into definition once it is built, see currentStates()
     std::vector<State> states;
 
-    // Keeps track of current state, at the beginning set to startState value
-    int currentState;
-
     // Stores index of start state in states, set to -1 meaning nothing assigned
     int startState = -1;
 
-    // Variables defined for this machine
+    // Variables defined for this machine, index in the vector is the variable slot
     std::vector<Variable> variables;
 
+    // Resolves variable names to slots in variables
+    SymbolTable variableSlots;
+
+    // Variables no state action assigns to, folded into compiled code as constants
+    std::unordered_map<std::string, Value> constantVariables;
+
     // All the machines inputs
     std::vector<std::string> inputs;
 
+    // Resolves input names to dense ids used by the transition tables, "" is the input of delayed transitions
+    SymbolTable inputSlots;
+
     // All the machines outputs
     std::vector<std::string> outputs;
 
     // Allowed types for variables
     std::vector<std::string> allowedTypes = {"int", "string", "char", "bool", "double", "float"};
 
-    // Contains output of the current state
-    std::unordered_map<std::string, std::string> currentOutput;
+    // Resolves output names to indices in the output row
+    SymbolTable outputSlots;
+
+    // Compiled snapshot of the machine, rebuilt on first use after the machine changes, owns the states while it exists
+    std::shared_ptr<MachineDefinition> definition;
 
-    // Contains whole output history
-    std::unordered_map<std::string, std::string> outputHistory;
+    // Runtime state of the simulation
+    MachineInstance instance;
 
-    // Value to tell if delay should be cancelled or not
-    bool delayCancel = false;
+    // Time source of delays and elapsed()
+    std::shared_ptr<Clock> clock = Clock::real();
+
+    // Values of the outputs over the processed events, guarded by mtx
+    OutputHistory outputHistory;
 
     // Value to tell if delay is active or not
     bool delayActive = false;
@@ -67,8 +92,51 @@ private:
     // Mutex for protecting shared data in the thread
     std::mutex mtx;
 
-    // For blocking threads
-    std::condition_variable cv;
+    // Fires delayed transitions from one thread, created on the first delay
+    std::unique_ptr<TimerWheel> timers;
+
+    // Timers run on their own thread, by default the owner calls pollTimers() so only one thread changes instance
+    bool timerThread = false;
+
+    // Records processed events, guarded by mtx
+    std::unique_ptr<TraceRecorder> trace;
+
+    // Trace or output history is being recorded, checked before taking the lock
+    std::atomic<bool> recording{false};
+
+    /**
+     * @struct PendingDelay
+     * @brief Delay in progress
+     */
+    struct PendingDelay {
+        TimerWheel::TimerId timer = TimerWheel::invalidTimer; // Timer firing the transition
+        std::shared_ptr<std::promise<int>> completion; // Resolved with the state once the delay ends, may be nullptr
+        int nextState = -1; // Target of the transition
+        bool withInput = false; // Target is entered with the input that took the transition, otherwise it is a delay-only transition
+        bool guarded = false; // Transition has a guard
+        std::string inputName; // Input that took the transition, used only withInput
+        std::string inputValue; // Value of the input
+        Clock::TimePoint due; // Time the transition fires, kept for snapshots
+    };
+
+    // Delays in progress
+    std::vector<PendingDelay> delayTimers;
+
+    /**
+     * @brief Gets states of the machine, held by the definition once it is built
+     */
+    const std::vector<State>& currentStates() const {
+        return definition ? definition->states : states;
+    }
+
+    /**
+     * @brief Takes states back from the definition and drops it, called before the states change
+     *
+     * States are moved out if nothing but this machine and its own instance holds the
+     * definition, the instance is bound to the new one before it runs again. They are
+     * copied only while another instance still runs the old definition.
+     */
+    void takeStates();
 
     /**
      * @brief Depth-first search for reachability check
@@ -92,54 +160,105 @@ private:
     TransitionExpression parseExpr(const std::string& expr);
 
     /**
-     * @brief Removes spaces after [ and before ]
-     * @param str String to trim
-     * @return Trimmed string
+     * @brief Processes one valid input of the synchronised instance
+     * @param inputId Id of the input in inputSlots
+     * @param inputName Input name
+     * @param inputValue Input value
      */
-    std::string trimBracketSpaces(std::string str);
+    void step(int inputId, const std::string& inputName, const std::string& inputValue, const std::shared_ptr<std::promise<int>>& completion = nullptr);
+
+    /**
+     * @brief Schedules delay, callback is called on the timer thread once it passes
+     * @param delay Delay in milliseconds
+     * @param pending Transition to fire, its timer and due time are filled here
+     */
+    void addDelay(int delay, PendingDelay pending);
+
+    /**
+     * @brief Appends the event that was just processed to the trace and the output history, if they are recorded
+     * @param kind What caused the event
+     * @param inputId Id of the input in inputSlots
+     * @param inputValue Input value
+     */
+    void recordEvent(Trace::Kind kind, int inputId, const std::string& inputValue);
+
+    /**
+     * @brief Cancels all delays in progress
+     * @return Completions of the delays, to be resolved by the caller
+     */
+    std::vector<std::shared_ptr<std::promise<int>>> takeDelays();
+
+    /**
+     * @brief Moves to the target of the delay-only transition whose timer fired, called on the timer thread
+     * @param nextState Destination state index
+     */
+    void finishDelay(int nextState);
+
+    /**
+     * @brief Enters the target of the guarded transition whose delay passed, called on the timer thread
+     * @param nextState Destination state index
+     * @param guarded Transition has a guard, delay-only transitions of the target are started then
+     * @param inputName Input of the event that took the transition
+     * @param inputValue Value of the input
+     */
+    void finishDelayedTransition(int nextState, bool guarded, const std::string& inputName, const std::string& inputValue);
+
+    /**
+     * @brief Tells waiting callers and the GUI about the state reached after a delay
+     * @param completions Completions of the delays that ended
+     */
+    void delayFinished(const std::vector<std::shared_ptr<std::promise<int>>>& completions);
 
     /**
-     * @brief Converts Variable to JSON
-     * @param var Variable to convert
-     * @return JSON representation of Variable
+     * @brief Optimizes and compiles output expression and all transition guards of the state
+     * @param state State to compile, one of states taken back by takeStates()
+     * @param action Parsed output expression of the state
      */
-    nlohmann::ordered_json varToJSON(const Variable& var);
+    void compileState(State& state, const AstPtr& action);
 
     /**
-     * @brief Converts TransitionExpression to JSON
-     * @param expr TransitionExpression to convert
-     * @return JSON representation of TransitionExpression
+     * @brief Binds the simulation instance to the current definition of the machine
      */
-    nlohmann::ordered_json transitionExprToJSON(const TransitionExpression& expr);
+    void syncInstance();
 
     /**
-     * @brief Converts State to JSON
-     * @param state State to convert
-     * @param onlyStates If true, only state info without transitions
-     * @return JSON representation of State
+     * @brief Starts the delay-only transition of the current state that fires first
      */
-    nlohmann::ordered_json stateToJSON(const State& state, bool onlyStates);
+    void startDelayedTransitions();
 
     /**
-     * @brief Converts JSON to Variable
-     * @param j JSON to convert
-     * @return Variable created from JSON
+     * @brief Precomputes outputs of the action if it only writes constants to outputs
+     * @param action Optimized output expression of the state
+     * @param row Receives outputs after the action, indexed by output slot
+     * @return true if the action is constant
      */
-    Variable jsonToVariable(const nlohmann::ordered_json& j);
+    bool buildOutputRow(const AstPtr& action, std::vector<std::string>& row);
 
     /**
-     * @brief Validates delay value format
-     * @param delayValue Delay value to check
-     * @return true if valid, false otherwise
+     * @brief Compiles newly added state, recompiles everything if it assigns a folded variable
+     * @param state State to compile, one of states taken back by takeStates()
      */
-    bool delayValid(const std::string& delayValue);
+    void compileNewState(State& state);
 
     /**
-     * @brief Parses delay value to milliseconds
-     * @param delayValue Delay value string
-     * @return Delay in milliseconds
+     * @brief Compiles all transitions of the state into its table grouped by input id
+     * @param state State to compile, one of states taken back by takeStates()
      */
-    int getDelayValue(const std::string& delayValue);
+    void compileTransitions(State& state);
+
+    /**
+     * @brief Compiles guard and resolves delay of the transition
+     * @param expr Transition expression
+     * @return Compiled transition
+     */
+    CompiledTransition compileTransition(const TransitionExpression& expr);
+
+    /**
+     * @brief Removes spaces after [ and before ]
+     * @param str String to trim
+     * @return Trimmed string
+     */
+    std::string trimBracketSpaces(std::string str);
 
 public:
     /**
@@ -147,6 +266,11 @@ public:
      */
     MooreMachine();
 
+    /**
+     * @brief Destructor, stops the timer thread before the callbacks lose the machine
+     */
+    ~MooreMachine();
+
     /**
      * @brief Gets current state index
      * @return Index of current state
@@ -214,7 +338,7 @@ public:
      * @param outputName Output name
      * @param outputValue Output value
      */
-    void setCurrentOutput(const std::string& outputName, const std::string& outputValue);
+    void setCurrentOutput(const std::string& outputName, std::string_view outputValue);
 
     /**
      * @brief Initializes all outputs to empty string
@@ -228,11 +352,26 @@ public:
 
     /**
      * @brief Processes input and performs transitions
+     *
+     * Never blocks, target of a transition with delay is entered by pollTimers()
+     * once the delay passes, or on the timer thread after setTimerThread(true),
+     * and autoTransition is called then.
+     *
      * @param inputName Input name
      * @param inputValue Input value
      */
     void processInput(const std::string& inputName, const std::string& inputValue);
 
+    /**
+     * @brief Processes input and reports the state the event leads to
+     * @param inputName Input name
+     * @param inputValue Input value
+     * @return Future of the state index, ready at once unless a delayed transition was taken,
+     *         the state the machine is in if the delay is interrupted, a delayed one is
+     *         resolved by pollTimers() or by the timer thread
+     */
+    std::future<int> processInputAsync(const std::string& inputName, const std::string& inputValue);
+
     /**
      * @brief Validates input name
      * @param inputName Input name to check
@@ -240,12 +379,40 @@ public:
      */
     bool isInputValid(const std::string& inputName);
 
+    /**
+     * @brief Looks up id of the input for processInputs()
+     * @param inputName Input name
+     * @return Id of the input, -1 if the input is not valid
+     */
+    int findInput(const std::string& inputName);
+
+    /**
+     * @brief Processes batch of input events, same as calling processInput() for each of them
+     *
+     * Definition is synchronised and inputs are validated by id once per batch,
+     * autoTransition is called once at the end if the batch moved the machine.
+     *
+     * @param events First event of the batch
+     * @param count Number of events
+     * @return State after each event and outputs that changed
+     */
+    EventBatchResult processInputs(const InputEvent* events, size_t count);
+
+    /**
+     * @brief Processes batch of input events
+     * @param events Events in the order they arrived
+     * @return State after each event and outputs that changed
+     */
+    EventBatchResult processInputs(const std::vector<InputEvent>& events) {
+        return processInputs(events.data(), events.size());
+    }
+
     /**
      * @brief Gets transitions for a state
      * @param currentState State to get transitions for
      * @return Map of transition expressions to destination states
      */
-    std::unordered_map<TransitionExpression, int> getTransitions(State& currentState);
+    const std::unordered_map<TransitionExpression, int>& getTransitions(const State& currentState);
 
     /**
      * @brief Gets all variables
@@ -261,16 +428,17 @@ public:
 
     /**
      * @brief Sets up delay transition
-     * @param delayValue Delay value string
+     * @param delay Delay in milliseconds
      * @param nextState Destination state index
      */
-    void handleDelay(const std::string& delayValue, int nextState);
+    void handleDelay(int delay, int nextState);
 
     /**
      * @brief Cancels current delay
      */
     void interruptDelay();
 
+
     /**
      * @brief Checks state reachability
      */
@@ -316,10 +484,37 @@ public:
     void loadFromJSONFile(const std::string& filename);
 
     /**
-     * @brief Gets machine as JSON object
-     * @return JSON representation of machine
+     * @brief Saves compiled machine as binary image, see MachineImage
+     * @param filename File to write
+     * @return true if the image was written
+     */
+    bool saveImage(const std::string& filename);
+
+    /**
+     * @brief Loads machine from binary image written by saveImage()
+     *
+     * Records of the mapped file are copied into the machine as they are, no JSON
+     * and no expression is parsed. Every name, table and program is still copied,
+     * so loading time grows with the size of the machine and the file is not used
+     * after this returns. Sources of expressions are kept, so the machine can still
+     * be edited and saved as JSON.
+     *
+     * @param filename File to load from
+     * @return false if the file is not a valid image, the machine is left empty then
      */
-    nlohmann::ordered_json getJson();
+    bool loadFromImage(const std::string& filename);
+
+    /**
+     * @brief Writes machine as JSON text, same text createJSONFile() saves
+     * @param out Stream to write to
+     */
+    void writeJson(std::ostream& out);
+
+    /**
+     * @brief Passes the machine part by part to the visitor, in the order of the JSON file
+     * @param visitor Receives the machine
+     */
+    void serialize(MachineVisitor& visitor);
 
     /**
      * @brief Gets machine name
@@ -339,10 +534,10 @@ public:
 
     /**
      * @brief Gets all states
-     * @return Reference to states vector
+     * @return Reference to states vector, valid until the machine is changed
      */
     const std::vector<State>& getStates() {
-        return states;
+        return currentStates();
     }
 
     /**
@@ -359,28 +554,173 @@ public:
      */
     std::string getCurrentOutput()
     {
-        std::string result;
-        for (const auto& [out, value] : currentOutput) {
-            result += out + ":" + value;
-        }
-        return result;
+        return instance.getCurrentOutput();
     }
 
     /**
-     * @brief Gets variables
+     * @brief Gets declared variables with their initial values
      * @return Reference to variables vector
      */
-    std::vector<Variable>& getVariables() {
+    const std::vector<Variable>& getVariables() {
         return variables;
     }
 
+    /**
+     * @brief Gets compiled snapshot of the machine, shareable by any number of instances
+     * @return Definition, the same object until the machine is modified
+     */
+    std::shared_ptr<const MachineDefinition> getDefinition();
+
+    /**
+     * @brief Gets runtime state of the simulation
+     * @return Simulation instance, values of variables are read from it
+     */
+    const MachineInstance& getInstance() {
+        syncInstance();
+        return instance;
+    }
+
+    /**
+     * @brief Recompiles all states, needed when set of variables or their initial values change
+     */
+    void compileAll();
+
+    /**
+     * @brief Looks up slot of the variable
+     * @param name Variable name
+     * @return Index of the variable in getVariables(), -1 if it does not exist
+     */
+    int findVariable(const std::string& name) const {
+        return variableSlots.find(name);
+    }
+
     /**
      * @brief Gets allowed variable types
      * @return Vector of allowed types
      */
     std::vector<std::string> getAllowedTypes();
 
-    // Callback function for auto transition to the next state (after delay)
+    /**
+     * @brief Sets time source of delays and elapsed(), VirtualClock makes delays take no real time
+     * @param clock Clock to use
+     */
+    void setClock(std::shared_ptr<Clock> clock);
+
+    /**
+     * @brief Gets time source of the machine
+     * @return Clock in use
+     */
+    const std::shared_ptr<Clock>& getClock() const {
+        return clock;
+    }
+
+    /**
+     * @brief Creates binary snapshot of the simulation: current state, variables, outputs and delays in progress
+     *
+     * Much smaller and faster than saving the machine as JSON, the machine itself is not
+     * part of it, it has to be loaded before the snapshot is restored.
+     *
+     * @return Snapshot
+     */
+    std::string saveSnapshot();
+
+    /**
+     * @brief Restores simulation saved by saveSnapshot(), delays continue with the time they had left
+     * @param data Snapshot
+     * @return false if the snapshot does not fit the machine, the simulation is left untouched then
+     */
+    bool restoreSnapshot(std::string_view data);
+
+    /**
+     * @brief Chooses who fires delayed transitions
+     *
+     * By default the owner calls pollTimers(). The timer thread changes the simulation
+     * without synchronising with the owner, so it is only meant for owners that do not
+     * use the machine while a delay may end, for example one waiting on processInputAsync().
+     *
+     * @param enabled true for the timer thread of the machine, false if the owner calls pollTimers()
+     */
+    void setTimerThread(bool enabled);
+
+    /**
+     * @brief Fires delayed transitions whose time came, on the calling thread
+     * @return Number of delays that ended
+     */
+    int pollTimers();
+
+    /**
+     * @brief Gets time pollTimers() should be called at
+     * @return Earliest time a delay may end, TimePoint::max() if no delay is in progress
+     */
+    Clock::TimePoint nextTimerDue() const;
+
+    /**
+     * @brief Starts recording every processed event into a binary trace, see Trace
+     *
+     * Trace starts with a snapshot of the simulation, so it can be replayed from this
+     * point. Records are buffered and written in large blocks, a trace recorded before
+     * is finished first.
+     *
+     * @param filename File to write
+     * @return true if the file was created
+     */
+    bool startTrace(const std::string& filename);
+
+    /**
+     * @brief Stops recording and writes the rest of the trace
+     */
+    void stopTrace();
+
+    /**
+     * @brief Feeds events of the trace back through the machine as fast as it can process them
+     *
+     * Simulation is restored from the snapshot of the trace and the machine is switched
+     * to a VirtualClock polled by the caller, so inputs come at their recorded times
+     * and delays end where the trace says they did, without waiting. State and outputs
+     * after every event are compared with the recorded ones. The machine stays on the
+     * virtual clock afterwards, setClock() switches it back.
+     *
+     * @param filename Trace written by startTrace(), the same machine has to be loaded
+     * @param result Receives number of events and mismatches
+     * @return false if the trace can not be read or does not fit the machine
+     */
+    bool replayTrace(const std::string& filename, TraceReplayResult& result);
+
+    /**
+     * @brief Starts keeping history of output values, every processed event is one step
+     *
+     * History starts over at step 0 with the current outputs, and again whenever the
+     * start state is processed. Only changes are kept, up to capacity of them per
+     * output, older ones are dropped.
+     *
+     * @param capacity Maximum number of changes kept per output, 0 stops keeping history
+     */
+    void setOutputHistory(size_t capacity);
+
+    /**
+     * @brief Gets step of the last event in the output history
+     */
+    uint64_t getHistoryStep();
+
+    /**
+     * @brief Gets value the output had after the step
+     * @param outputName Output name
+     * @param step Step of the output history
+     * @param value Receives the value
+     * @return false if the output does not exist or the step is not in the history
+     */
+    bool getOutputAt(const std::string& outputName, uint64_t step, std::string& value);
+
+    /**
+     * @brief Gets changes of the output between two steps of the output history, both included
+     * @param outputName Output name
+     * @param from First step
+     * @param to Last step
+     * @return Changes in step order, empty if the output does not exist
+     */
+    std::vector<OutputSample> getOutputChanges(const std::string& outputName, uint64_t from, uint64_t to);
+
+    // Callback function for auto transition to the next state (after delay), called on the thread that fired the delay
     std::function<void(int)> autoTransition;
 
     /**
@@ -0,0 +1,151 @@
+/**
+ * @file OutputHistory.cpp
+ * @brief Implementation of the OutputHistory class
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#include <limits>
+#include "OutputHistory.h"
+
+using namespace std;
+
+void OutputHistory::reset(size_t capacity, const vector<string>& outputs) {
+    this->capacity = capacity;
+    columns.clear();
+    step = 0;
+    if (capacity > 0) {
+        store(outputs);
+    }
+}
+
+void OutputHistory::record(const vector<string>& outputs) {
+    if (capacity > 0) {
+        step++;
+        store(outputs);
+    }
+}
+
+void OutputHistory::store(const vector<string>& outputs) {
+    // Outputs added while the history runs start with the value they have now
+    while (columns.size() < outputs.size()) {
+        columns.emplace_back();
+        Column& column = columns.back();
+        column.steps.resize(capacity);
+        column.values.resize(capacity);
+        append(column, step, outputs[columns.size() - 1]);
+    }
+
+    for (size_t slot = 0; slot < outputs.size(); slot++) {
+        Column& column = columns[slot];
+        uint32_t last = column.values[at(column, column.count - 1)];
+        if (column.dictionary[last] != outputs[slot]) {
+            append(column, step, outputs[slot]);
+        }
+    }
+}
+
+uint32_t OutputHistory::intern(Column& column, const string& value) {
+    auto found = column.ids.find(value);
+    if (found != column.ids.end()) {
+        return found->second;
+    }
+
+    uint32_t id;
+    if (!column.freeIds.empty()) {
+        id = column.freeIds.back();
+        column.freeIds.pop_back();
+        column.dictionary[id] = value;
+    }
+    else {
+        id = static_cast<uint32_t>(column.dictionary.size());
+        column.dictionary.push_back(value);
+        column.references.push_back(0);
+    }
+    column.ids.emplace(value, id);
+    return id;
+}
+
+void OutputHistory::append(Column& column, uint64_t step, const string& value) {
+    // Oldest change gives its place, its value leaves the dictionary once nothing uses it
+    if (column.count == capacity) {
+        uint32_t dropped = column.values[column.head];
+        if (--column.references[dropped] == 0) {
+            column.ids.erase(column.dictionary[dropped]);
+            column.dictionary[dropped].clear();
+            column.dictionary[dropped].shrink_to_fit();
+            column.freeIds.push_back(dropped);
+        }
+        column.head = (column.head + 1) % capacity;
+        column.count--;
+    }
+
+    uint32_t id = intern(column, value);
+    column.references[id]++;
+    size_t index = at(column, column.count);
+    column.steps[index] = step;
+    column.values[index] = id;
+    column.count++;
+}
+
+size_t OutputHistory::find(const Column& column, uint64_t step) const {
+    // Steps grow along the ring, binary search for the last one not after the step
+    size_t low = 0;
+    size_t high = column.count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (column.steps[at(column, middle)] <= step) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+    return low == 0 ? column.count : low - 1;
+}
+
+bool OutputHistory::valueAt(size_t slot, uint64_t step, string& value) const {
+    if (slot >= columns.size() || step > this->step) {
+        return false;
+    }
+    const Column& column = columns[slot];
+    size_t index = find(column, step);
+    if (index == column.count) {
+        return false;
+    }
+    value = column.dictionary[column.values[at(column, index)]];
+    return true;
+}
+
+vector<OutputSample> OutputHistory::changes(size_t slot, uint64_t from, uint64_t to) const {
+    vector<OutputSample> result;
+    if (slot >= columns.size() || from > to) {
+        return result;
+    }
+    const Column& column = columns[slot];
+
+    // First change inside the range, the one found is at or before from
+    size_t index = find(column, from);
+    if (index == column.count) {
+        index = 0;
+    }
+    else if (column.steps[at(column, index)] < from) {
+        index++;
+    }
+
+    for (; index < column.count; index++) {
+        size_t position = at(column, index);
+        if (column.steps[position] > to) {
+            break;
+        }
+        result.push_back({column.steps[position], column.dictionary[column.values[position]]});
+    }
+    return result;
+}
+
+uint64_t OutputHistory::firstStep(size_t slot) const {
+    if (slot >= columns.size() || columns[slot].count == 0) {
+        return numeric_limits<uint64_t>::max();
+    }
+    const Column& column = columns[slot];
+    return column.steps[column.head];
+}
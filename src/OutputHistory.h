@@ -0,0 +1,150 @@
+/**
+ * @file OutputHistory.h
+ * @brief Header file for the OutputHistory class, bounded history of output values
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#ifndef OUTPUTHISTORY_H
+#define OUTPUTHISTORY_H
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @struct OutputSample
+ * @brief Value an output got at a step
+ */
+struct OutputSample {
+    uint64_t step; // Step the value was set at
+    std::string value; // Value of the output
+};
+
+/**
+ * @class OutputHistory
+ * @brief Values of every output over the processed events, kept in bounded columns
+ *
+ * Every processed event is one step, step 0 holds the outputs the history started
+ * with. Each output has its own column holding only the steps its value changed at,
+ * values are stored as ids into a dictionary of the column, so a repeated value
+ * costs four bytes. Columns are ring buffers of fixed capacity, once one is full its
+ * oldest change is dropped and steps before the oldest kept change can not be queried.
+ */
+class OutputHistory {
+private:
+    /**
+     * @struct Column
+     * @brief Changes of one output, steps and value ids are separate arrays of the ring
+     */
+    struct Column {
+        std::vector<uint64_t> steps; // Step of each change
+        std::vector<uint32_t> values; // Dictionary id of each change
+        size_t head = 0; // Index of the oldest change
+        size_t count = 0; // Number of kept changes
+        std::vector<std::string> dictionary; // Distinct values, indexed by id
+        std::vector<uint32_t> references; // Number of changes using each id
+        std::vector<uint32_t> freeIds; // Ids no change uses, reused first
+        std::unordered_map<std::string, uint32_t> ids; // Value to its id
+    };
+
+    // Columns indexed by output slot
+    std::vector<Column> columns;
+
+    // Maximum number of changes kept per output, 0 means no history is kept
+    size_t capacity = 0;
+
+    // Step of the last recorded event
+    uint64_t step = 0;
+
+    /**
+     * @brief Gets ring index of the i-th oldest change of the column
+     */
+    size_t at(const Column& column, size_t i) const {
+        size_t index = column.head + i;
+        return index < capacity ? index : index - capacity;
+    }
+
+    /**
+     * @brief Finds the newest change at or before the step
+     * @return Index among the kept changes, count of the column if there is none
+     */
+    size_t find(const Column& column, uint64_t step) const;
+
+    /**
+     * @brief Stores outputs at the current step
+     */
+    void store(const std::vector<std::string>& outputs);
+
+    /**
+     * @brief Appends change to the column, drops the oldest one if it is full
+     */
+    void append(Column& column, uint64_t step, const std::string& value);
+
+    /**
+     * @brief Gets id of the value, adds it to the dictionary if needed
+     */
+    uint32_t intern(Column& column, const std::string& value);
+
+public:
+    /**
+     * @brief Creates empty history that keeps nothing until reset()
+     */
+    OutputHistory() = default;
+
+    /**
+     * @brief Drops everything and starts again at step 0
+     * @param capacity Maximum number of changes kept per output, 0 turns the history off
+     * @param outputs Values of the outputs at step 0, indexed by output slot
+     */
+    void reset(size_t capacity, const std::vector<std::string>& outputs);
+
+    /**
+     * @brief Records outputs after the next event, only those that changed are stored
+     * @param outputs Values of the outputs, indexed by output slot, new slots start at this step
+     */
+    void record(const std::vector<std::string>& outputs);
+
+    /**
+     * @brief Gets value the output had after the step
+     * @param slot Output slot
+     * @param step Step to look at
+     * @param value Receives the value
+     * @return false if the step is not recorded yet or was dropped
+     */
+    bool valueAt(size_t slot, uint64_t step, std::string& value) const;
+
+    /**
+     * @brief Gets changes of the output between two steps, both included
+     * @param slot Output slot
+     * @param from First step
+     * @param to Last step
+     * @return Kept changes in step order
+     */
+    std::vector<OutputSample> changes(size_t slot, uint64_t from, uint64_t to) const;
+
+    /**
+     * @brief Gets first step the output can be queried at
+     * @param slot Output slot
+     * @return Step of the oldest kept change, UINT64_MAX if the output has no history
+     */
+    uint64_t firstStep(size_t slot) const;
+
+    /**
+     * @brief Gets step of the last recorded event
+     */
+    uint64_t getStep() const {
+        return step;
+    }
+
+    /**
+     * @brief Gets maximum number of changes kept per output
+     */
+    size_t getCapacity() const {
+        return capacity;
+    }
+};
+
+#endif // OUTPUTHISTORY_H
@@ -0,0 +1,288 @@
+/**
+ * @file SessionScheduler.cpp
+ * @brief Implementation of the SessionScheduler class
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#include <iostream>
+#include "CodeExecutor.h"
+#include "SessionScheduler.h"
+
+using namespace std;
+
+SessionScheduler::SessionScheduler(shared_ptr<const MachineDefinition> definition, int workerCount, shared_ptr<Clock> clock)
+    : definition(move(definition)), clock(move(clock)), timers(this->clock) {
+    if (workerCount <= 0) {
+        workerCount = max(1, static_cast<int>(thread::hardware_concurrency()));
+    }
+    for (int i = 0; i < workerCount; i++) {
+        runQueues.push_back(make_unique<BoundedQueue<Session*>>(runQueueCapacity));
+    }
+}
+
+SessionScheduler::~SessionScheduler() {
+    stop();
+}
+
+int SessionScheduler::addSession(const string& key) {
+    if (running) {
+        cout << "Session \"" << key << "\" can not be added while the scheduler runs" << endl;
+        return -1;
+    }
+
+    auto it = sessionIds.find(key);
+    if (it != sessionIds.end()) {
+        return it->second;
+    }
+
+    auto session = make_unique<Session>();
+    session->key = key;
+    session->owner = static_cast<int>(hash<string>()(key) % runQueues.size());
+    session->instance.setDefinition(definition);
+    session->instance.setClock(clock);
+    sessions.push_back(move(session));
+
+    // Session is in at most one run queue at a time, so a queue as large as the session count never fills
+    if (sessions.size() > runQueueCapacity) {
+        growRunQueues(runQueueCapacity * 2);
+    }
+
+    int id = static_cast<int>(sessions.size()) - 1;
+    sessionIds.emplace(key, id);
+    return id;
+}
+
+void SessionScheduler::growRunQueues(size_t capacity) {
+    runQueueCapacity = capacity;
+    for (auto& queue : runQueues) {
+        auto grown = make_unique<BoundedQueue<Session*>>(capacity);
+        Session* session;
+        while (queue->pop(session)) {
+            grown->push(session);
+        }
+        queue = move(grown);
+    }
+}
+
+void SessionScheduler::setStateCallback(StateCallback callback) {
+    stateEntered = move(callback);
+}
+
+void SessionScheduler::start() {
+    if (running) {
+        return;
+    }
+
+    for (auto& session : sessions) {
+        session->instance.start();
+        entered(*session);
+    }
+
+    running = true;
+    for (int i = 0; i < static_cast<int>(runQueues.size()); i++) {
+        workers.emplace_back(&SessionScheduler::work, this, i);
+    }
+}
+
+void SessionScheduler::stop() {
+    if (!running.exchange(false)) {
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(idleMutex);
+    }
+    idle.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+bool SessionScheduler::post(const string& key, const string& inputName, const string& inputValue) {
+    auto it = sessionIds.find(key);
+    if (it == sessionIds.end()) {
+        cout << "Session \"" << key << "\" does not exist" << endl;
+        return false;
+    }
+    post(it->second, inputName, inputValue);
+    return true;
+}
+
+void SessionScheduler::post(int session, const string& inputName, const string& inputValue) {
+    SessionEvent event;
+    event.inputName = inputName;
+    event.inputValue = inputValue;
+    pendingEvents.fetch_add(1, memory_order_relaxed);
+    enqueue(*sessions[session], move(event));
+}
+
+void SessionScheduler::enqueue(Session& session, SessionEvent event) {
+    session.queued.fetch_add(1, memory_order_seq_cst);
+    session.events.push(move(event));
+
+    // Only the poster that flips the flag schedules the session, the rest find it queued
+    if (!session.scheduled.exchange(true, memory_order_seq_cst)) {
+        schedule(session.owner, &session);
+    }
+}
+
+void SessionScheduler::schedule(int worker, Session* session) {
+    // Queues hold every session at once, the push can not fail and workers never wait on their own queue
+    runQueues[worker]->push(session);
+
+    // Pairs with the fence in work(), either a worker going to sleep finds the session or this sees it sleeping
+    atomic_thread_fence(memory_order_seq_cst);
+    if (sleepers.load(memory_order_relaxed) > 0) {
+        lock_guard<mutex> lock(idleMutex);
+        idle.notify_one();
+    }
+}
+
+void SessionScheduler::waitIdle() {
+    while (pendingEvents.load(memory_order_acquire) > 0) {
+        this_thread::yield();
+    }
+}
+
+void SessionScheduler::work(int self) {
+    int misses = 0;
+    while (running.load(memory_order_acquire)) {
+        fireTimers();
+
+        Session* session;
+        if (findWork(self, session)) {
+            misses = 0;
+            run(self, *session);
+            continue;
+        }
+
+        // Spin shortly before sleeping, events usually come in bursts
+        if (++misses < 64) {
+            this_thread::yield();
+            continue;
+        }
+
+        // Sleep until work is scheduled, wake up in time for the next delay
+        // Virtual time does not map to real time, so the sleep is also capped
+        unique_lock<mutex> lock(idleMutex);
+        sleepers++;
+
+        // Session scheduled after the search above is found here, or its poster sees the sleeper and notifies
+        atomic_thread_fence(memory_order_seq_cst);
+        if (findWork(self, session)) {
+            sleepers--;
+            lock.unlock();
+            misses = 0;
+            run(self, *session);
+            continue;
+        }
+
+        Clock::TimePoint::duration sleep = chrono::milliseconds(10);
+        Clock::TimePoint due = timers.nextDue();
+        if (due != Clock::TimePoint::max()) {
+            sleep = min(sleep, due - clock->now());
+        }
+        idle.wait_for(lock, sleep);
+        sleepers--;
+        misses = 0;
+    }
+}
+
+bool SessionScheduler::findWork(int self, Session*& session) {
+    if (runQueues[self]->pop(session)) {
+        return true;
+    }
+
+    // Steal from the other workers, each starts with a different victim
+    int count = static_cast<int>(runQueues.size());
+    for (int i = 1; i < count; i++) {
+        if (runQueues[(self + i) % count]->pop(session)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SessionScheduler::run(int self, Session& session) {
+    SessionEvent event;
+    for (int i = 0; i < eventBudget && session.events.pop(event); i++) {
+        session.queued.fetch_sub(1, memory_order_relaxed);
+        process(session, event);
+        if (event.delayedState == -1) {
+            pendingEvents.fetch_sub(1, memory_order_release);
+        }
+    }
+
+    // Events posted while the flag was still set would be lost without the second check
+    session.scheduled.store(false, memory_order_seq_cst);
+    if (session.queued.load(memory_order_seq_cst) > 0 && !session.scheduled.exchange(true, memory_order_acq_rel)) {
+        schedule(self, &session);
+    }
+}
+
+void SessionScheduler::process(Session& session, SessionEvent& event) {
+    MachineInstance& instance = session.instance;
+
+    // Delay passed, enter the target unless the session moved on in between
+    if (event.delayedState != -1) {
+        if (event.generation != session.generation) {
+            return;
+        }
+        session.generation++;
+        instance.resetOutputs();
+
+        // Action of the target sees the input that took the transition, as in MooreMachine
+        CodeExecutor executor(instance, event.inputName, event.inputValue);
+        instance.enterState(event.delayedState, executor);
+        entered(session);
+        return;
+    }
+
+    const CompiledTransition* transition = instance.processInput(event.inputName, event.inputValue);
+    if (!transition) {
+        return;
+    }
+
+    session.generation++;
+    int delay = instance.view().getDelayValue(*transition);
+    if (delay != -1) {
+        startDelay(session, delay, transition->nextState, event.inputName, event.inputValue);
+    }
+    else {
+        entered(session);
+    }
+}
+
+void SessionScheduler::entered(Session& session) {
+    if (stateEntered) {
+        stateEntered(session.key, session.instance);
+    }
+
+    // Delay-only transition of the new state starts right away
+    int nextState;
+    int delay = session.instance.view().getEntryDelay(nextState);
+    if (delay != -1) {
+        startDelay(session, delay, nextState);
+    }
+}
+
+void SessionScheduler::startDelay(Session& session, int delay, int state, const string& inputName, const string& inputValue) {
+    // Expired delay goes through the session queue, so it is ordered with the inputs
+    timers.schedule(chrono::milliseconds(delay), [this, &session, state, generation = session.generation, inputName, inputValue] {
+        SessionEvent event;
+        event.inputName = inputName;
+        event.inputValue = inputValue;
+        event.delayedState = state;
+        event.generation = generation;
+        enqueue(session, move(event));
+    });
+}
+
+void SessionScheduler::fireTimers() {
+    // Cheap check without the lock, most calls find nothing due
+    if (clock->now() < timers.nextDue()) {
+        return;
+    }
+    timers.poll();
+}
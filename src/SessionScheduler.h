@@ -0,0 +1,262 @@
+/**
+ * @file SessionScheduler.h
+ * @brief Header file for the SessionScheduler class, parallel simulation of independent instances
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#ifndef SESSIONSCHEDULER_H
+#define SESSIONSCHEDULER_H
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Clock.h"
+#include "LockFreeQueue.h"
+#include "MachineDefinition.h"
+#include "MachineInstance.h"
+#include "TimerWheel.h"
+
+/**
+ * @class SessionScheduler
+ * @brief Runs many MachineInstance objects of one definition on a pool of worker threads
+ *
+ * Every session (instance keyed by a name) has its own lock-free event queue and
+ * belongs to the worker chosen by hash of its key. A session with events waiting is
+ * put into the run queue of its worker, idle workers steal sessions from the run
+ * queues of the others. A session is run by one worker at a time and its events
+ * are processed in the order they were posted.
+ *
+ * Delayed transitions do not block a worker, the target state is entered by an
+ * internal event posted when the delay passes. Taking any other transition first
+ * cancels it.
+ */
+class SessionScheduler {
+public:
+    // Called on a worker thread whenever a session enters a state
+    using StateCallback = std::function<void(const std::string& session, const MachineInstance& instance)>;
+
+private:
+    /**
+     * @struct SessionEvent
+     * @brief Input posted to a session or its expired delay
+     */
+    struct SessionEvent {
+        std::string inputName; // Name of the input, for delays the input that took the transition
+        std::string inputValue; // Value of the input
+        int delayedState = -1; // Target of the expired delayed transition, -1 for inputs
+        unsigned long generation = 0; // Session generation the delay was started in
+    };
+
+    /**
+     * @struct Session
+     * @brief One instance together with its event queue
+     */
+    struct Session {
+        std::string key; // Name of the session
+        int owner = 0; // Worker whose run queue the session is put into
+        MachineInstance instance; // Runtime state of the automaton
+        MpscQueue<SessionEvent> events; // Events waiting to be processed
+        std::atomic<int> queued{0}; // Number of events pushed and not popped yet
+        std::atomic<bool> scheduled{false}; // Session is in a run queue or being run
+        unsigned long generation = 0; // Incremented on every transition, outdates pending delays
+    };
+
+    // Automaton run by all sessions
+    std::shared_ptr<const MachineDefinition> definition;
+
+    // Time source of delays and of all sessions
+    std::shared_ptr<Clock> clock;
+
+    // Sessions in the order they were added
+    std::vector<std::unique_ptr<Session>> sessions;
+
+    // Session keys to indices in sessions
+    std::unordered_map<std::string, int> sessionIds;
+
+    // Run queue of every worker
+    std::vector<std::unique_ptr<BoundedQueue<Session*>>> runQueues;
+
+    // Capacity of every run queue, never less than the number of sessions
+    size_t runQueueCapacity = 64;
+
+    // Worker threads
+    std::vector<std::thread> workers;
+
+    // Workers keep running while set
+    std::atomic<bool> running{false};
+
+    // Number of posted events not processed yet
+    std::atomic<long> pendingEvents{0};
+
+    // Delays in progress, fired by the workers
+    TimerWheel timers;
+
+    // Wakes idle workers
+    std::mutex idleMutex;
+    std::condition_variable idle;
+
+    // Number of workers waiting on idle
+    std::atomic<int> sleepers{0};
+
+    // Called when a session enters a state
+    StateCallback stateEntered;
+
+    // Number of events one session may process before other sessions of the worker get their turn
+    static constexpr int eventBudget = 64;
+
+    /**
+     * @brief Loop of one worker thread
+     * @param self Index of the worker
+     */
+    void work(int self);
+
+    /**
+     * @brief Takes runnable session from the worker's run queue or steals one from the others
+     * @param self Index of the worker
+     * @param session Receives the session
+     * @return false if no session is runnable
+     */
+    bool findWork(int self, Session*& session);
+
+    /**
+     * @brief Processes events of the session, puts it back to the run queue if events remain
+     * @param self Index of the worker
+     * @param session Session to run
+     */
+    void run(int self, Session& session);
+
+    /**
+     * @brief Processes one event of the session
+     * @param session Session the event belongs to
+     * @param event Event to process
+     */
+    void process(Session& session, SessionEvent& event);
+
+    /**
+     * @brief Notifies callback and starts delay-only transition of the state the session entered
+     * @param session Session that entered a state
+     */
+    void entered(Session& session);
+
+    /**
+     * @brief Starts delayed transition of the session
+     * @param session Session taking the transition
+     * @param delay Delay in milliseconds
+     * @param state Target of the transition
+     * @param inputName Input that took the transition, its action sees it once the delay passes
+     * @param inputValue Value of the input
+     */
+    void startDelay(Session& session, int delay, int state, const std::string& inputName = "", const std::string& inputValue = "");
+
+    /**
+     * @brief Replaces run queues by larger ones, sessions already queued are moved over
+     * @param capacity New capacity of every run queue
+     */
+    void growRunQueues(size_t capacity);
+
+    /**
+     * @brief Posts events of the delays that passed
+     */
+    void fireTimers();
+
+    /**
+     * @brief Appends event to the session and makes the session runnable
+     * @param session Target session
+     * @param event Event to append
+     */
+    void enqueue(Session& session, SessionEvent event);
+
+    /**
+     * @brief Puts session into the run queue of a worker and wakes a sleeping worker
+     * @param worker Index of the worker
+     * @param session Runnable session
+     */
+    void schedule(int worker, Session* session);
+
+public:
+    /**
+     * @brief Creates stopped scheduler
+     * @param definition Automaton run by all sessions
+     * @param workerCount Number of worker threads, 0 uses number of hardware threads
+     * @param clock Time source of delays, a VirtualClock fires them when it is advanced
+     */
+    explicit SessionScheduler(std::shared_ptr<const MachineDefinition> definition, int workerCount = 0, std::shared_ptr<Clock> clock = Clock::real());
+
+    /**
+     * @brief Stops the workers, events not processed yet are dropped
+     */
+    ~SessionScheduler();
+
+    SessionScheduler(const SessionScheduler&) = delete;
+    SessionScheduler& operator=(const SessionScheduler&) = delete;
+
+    /**
+     * @brief Adds session in the start state, only allowed while the scheduler is stopped
+     * @param key Name of the session
+     * @return Index of the session, existing index if the key was added before
+     */
+    int addSession(const std::string& key);
+
+    /**
+     * @brief Sets callback called on worker threads when a session enters a state, only allowed while stopped
+     * @param callback Callback, may be empty
+     */
+    void setStateCallback(StateCallback callback);
+
+    /**
+     * @brief Executes start state actions of all sessions and starts the workers
+     */
+    void start();
+
+    /**
+     * @brief Stops and joins the workers, events not processed yet stay queued
+     */
+    void stop();
+
+    /**
+     * @brief Posts input to the session, safe to call from any thread
+     * @param key Name of the session
+     * @param inputName Input name
+     * @param inputValue Input value
+     * @return false if the session does not exist
+     */
+    bool post(const std::string& key, const std::string& inputName, const std::string& inputValue);
+
+    /**
+     * @brief Posts input to the session, safe to call from any thread
+     * @param session Index of the session from addSession()
+     * @param inputName Input name
+     * @param inputValue Input value
+     */
+    void post(int session, const std::string& inputName, const std::string& inputValue);
+
+    /**
+     * @brief Waits until all posted events are processed, pending delays are not waited for
+     */
+    void waitIdle();
+
+    /**
+     * @brief Gets number of sessions
+     */
+    int size() const {
+        return static_cast<int>(sessions.size());
+    }
+
+    /**
+     * @brief Gets instance of the session, only safe to read while idle or stopped
+     * @param session Index of the session
+     */
+    const MachineInstance& getInstance(int session) const {
+        return sessions[session]->instance;
+    }
+};
+
+#endif // SESSIONSCHEDULER_H
@@ -0,0 +1,239 @@
+/**
+ * @file Snapshot.cpp
+ * @brief Implementation of the snapshot writer and reader
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#include <cstring>
+#include <iostream>
+#include "Snapshot.h"
+
+using namespace std;
+
+// Columns are copied as they are when the host already stores ints little endian
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define SNAPSHOT_LITTLE_ENDIAN
+#endif
+
+static void hashBytes(uint64_t& hash, string_view bytes) {
+    for (char ch : bytes) {
+        hash ^= static_cast<unsigned char>(ch);
+        hash *= 0x100000001b3ULL;
+    }
+    // Separator, so "ab","c" and "a","bc" differ
+    hash ^= 0xff;
+    hash *= 0x100000001b3ULL;
+}
+
+uint64_t Snapshot::fingerprint(const MachineDefinition& definition) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const State& state : definition.states) {
+        hashBytes(hash, state.name);
+    }
+    hashBytes(hash, "|");
+    for (const Variable& var : definition.variables) {
+        hashBytes(hash, var.name);
+        hashBytes(hash, var.type);
+    }
+    hashBytes(hash, "|");
+    for (int slot = 0; slot < definition.outputSlots.size(); slot++) {
+        hashBytes(hash, definition.outputSlots.name(slot));
+    }
+    return hash;
+}
+
+void SnapshotWriter::header(Snapshot::Kind kind, const MachineDefinition& definition) {
+    u32(Snapshot::magic);
+    u8(Snapshot::version & 0xff);
+    u8(Snapshot::version >> 8);
+    u8(static_cast<uint8_t>(kind));
+    u64(Snapshot::fingerprint(definition));
+}
+
+void SnapshotWriter::u32(uint32_t value) {
+    char bytes[4];
+    for (int i = 0; i < 4; i++) {
+        bytes[i] = static_cast<char>(value >> (8 * i));
+    }
+    out.append(bytes, 4);
+}
+
+void SnapshotWriter::u64(uint64_t value) {
+    char bytes[8];
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = static_cast<char>(value >> (8 * i));
+    }
+    out.append(bytes, 8);
+}
+
+void SnapshotWriter::f64(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    u64(bits);
+}
+
+void SnapshotWriter::i32s(const int* values, size_t count) {
+#ifdef SNAPSHOT_LITTLE_ENDIAN
+    out.append(reinterpret_cast<const char*>(values), count * sizeof(int));
+#else
+    for (size_t i = 0; i < count; i++) {
+        i32(values[i]);
+    }
+#endif
+}
+
+void SnapshotWriter::text(string_view value) {
+    u32(static_cast<uint32_t>(value.size()));
+    out.append(value.data(), value.size());
+}
+
+void SnapshotWriter::value(const Value& value) {
+    u8(static_cast<uint8_t>(value.getType()));
+    valuePayload(value);
+}
+
+void SnapshotWriter::valuePayload(const Value& value) {
+    switch (value.getType()) {
+        case ValueType::Int:
+            i32(value.asInt());
+            break;
+        case ValueType::Double:
+            f64(value.asDouble());
+            break;
+        case ValueType::Bool:
+            u8(value.asBool() ? 1 : 0);
+            break;
+        case ValueType::Char:
+            u8(static_cast<uint8_t>(value.asInt()));
+            break;
+        case ValueType::String:
+            text(value.asString());
+            break;
+    }
+}
+
+const char* SnapshotReader::take(size_t size) {
+    if (failed || static_cast<size_t>(end - pos) < size) {
+        failed = true;
+        return nullptr;
+    }
+    const char* bytes = pos;
+    pos += size;
+    return bytes;
+}
+
+bool SnapshotReader::header(Snapshot::Kind kind, const MachineDefinition& definition) {
+    if (u32() != Snapshot::magic) {
+        cout << "Data is not a snapshot" << endl;
+        return false;
+    }
+    uint16_t version = u8();
+    version |= static_cast<uint16_t>(u8()) << 8;
+    if (version != Snapshot::version) {
+        cout << "Snapshot version " << version << " is not supported" << endl;
+        return false;
+    }
+    if (u8() != static_cast<uint8_t>(kind)) {
+        cout << "Snapshot holds different kind of state" << endl;
+        return false;
+    }
+    if (u64() != Snapshot::fingerprint(definition)) {
+        cout << "Snapshot was taken from different machine" << endl;
+        return false;
+    }
+    return ok();
+}
+
+uint8_t SnapshotReader::u8() {
+    const char* bytes = take(1);
+    return bytes ? static_cast<uint8_t>(bytes[0]) : 0;
+}
+
+uint32_t SnapshotReader::u32() {
+    const char* bytes = take(4);
+    if (!bytes) {
+        return 0;
+    }
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= static_cast<uint32_t>(static_cast<unsigned char>(bytes[i])) << (8 * i);
+    }
+    return value;
+}
+
+uint64_t SnapshotReader::u64() {
+    const char* bytes = take(8);
+    if (!bytes) {
+        return 0;
+    }
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(bytes[i])) << (8 * i);
+    }
+    return value;
+}
+
+double SnapshotReader::f64() {
+    uint64_t bits = u64();
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+void SnapshotReader::i32s(int* values, size_t count) {
+#ifdef SNAPSHOT_LITTLE_ENDIAN
+    const char* bytes = take(count * sizeof(int));
+    if (bytes) {
+        memcpy(values, bytes, count * sizeof(int));
+    }
+#else
+    for (size_t i = 0; i < count; i++) {
+        values[i] = i32();
+    }
+#endif
+}
+
+void SnapshotReader::text(string& value) {
+    uint32_t size = u32();
+    const char* bytes = take(size);
+    if (bytes) {
+        value.assign(bytes, size);
+    }
+    else {
+        value.clear();
+    }
+}
+
+void SnapshotReader::value(Value& value) {
+    uint8_t type = u8();
+    if (type > static_cast<uint8_t>(ValueType::String)) {
+        failed = true;
+        return;
+    }
+    valuePayload(static_cast<ValueType>(type), value);
+}
+
+void SnapshotReader::valuePayload(ValueType type, Value& value) {
+    switch (type) {
+        case ValueType::Int:
+            value = static_cast<int>(i32());
+            break;
+        case ValueType::Double:
+            value = f64();
+            break;
+        case ValueType::Bool:
+            value = u8() != 0;
+            break;
+        case ValueType::Char:
+            value = static_cast<char>(u8());
+            break;
+        case ValueType::String: {
+            uint32_t size = u32();
+            const char* bytes = take(size);
+            value = bytes ? string(bytes, size) : string();
+            break;
+        }
+    }
+}
+
+#undef SNAPSHOT_LITTLE_ENDIAN
@@ -0,0 +1,196 @@
+/**
+ * @file Snapshot.h
+ * @brief Binary format of runtime state snapshots, used by MachineInstance, InstancePool and MooreMachine
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "MachineDefinition.h"
+#include "Value.h"
+
+/**
+ * @struct Snapshot
+ * @brief Constants of the snapshot format
+ *
+ * Snapshot starts with a header: magic, format version, kind of the snapshot and
+ * fingerprint of the definition it was taken from. Numbers are little endian,
+ * strings are prefixed by their length. Only runtime state is stored, the
+ * definition has to be loaded before restoring and its fingerprint has to match.
+ */
+struct Snapshot {
+    // First four bytes of every snapshot
+    static constexpr uint32_t magic = 0x4E534D4D; // "MMSN"
+
+    // Incremented whenever the layout changes, older snapshots are refused
+    static constexpr uint16_t version = 2;
+
+    /**
+     * @enum Kind
+     * @brief What the snapshot holds
+     */
+    enum class Kind : uint8_t { Instance = 1, Pool = 2, Machine = 3 };
+
+    /**
+     * @brief Hashes the parts of the definition runtime state refers to
+     *
+     * State names, variable names and types and outputs are hashed in slot order, so
+     * a snapshot restores only into a definition where ids mean the same thing.
+     * Transitions and expressions are not part of it, they can change in between.
+     *
+     * @param definition Compiled machine
+     * @return 64 bit FNV-1a hash
+     */
+    static uint64_t fingerprint(const MachineDefinition& definition);
+};
+
+/**
+ * @class SnapshotWriter
+ * @brief Appends snapshot fields to a byte string
+ */
+class SnapshotWriter {
+private:
+    // Bytes written so far
+    std::string& out;
+
+public:
+    /**
+     * @brief Creates writer appending to the string
+     * @param out Output buffer
+     */
+    explicit SnapshotWriter(std::string& out) : out(out) {}
+
+    /**
+     * @brief Writes header of the snapshot
+     * @param kind What the snapshot holds
+     * @param definition Definition the state belongs to
+     */
+    void header(Snapshot::Kind kind, const MachineDefinition& definition);
+
+    void u8(uint8_t value) {
+        out.push_back(static_cast<char>(value));
+    }
+
+    void u32(uint32_t value);
+    void i32(int32_t value) {
+        u32(static_cast<uint32_t>(value));
+    }
+    void u64(uint64_t value);
+    void f64(double value);
+
+    /**
+     * @brief Writes column of ints, copied at once on little endian hosts
+     * @param values First value
+     * @param count Number of values
+     */
+    void i32s(const int* values, size_t count);
+
+    /**
+     * @brief Writes string prefixed by its length
+     */
+    void text(std::string_view value);
+
+    /**
+     * @brief Writes runtime type followed by the value
+     */
+    void value(const Value& value);
+
+    /**
+     * @brief Writes value without its type, for columns whose values share one type
+     */
+    void valuePayload(const Value& value);
+};
+
+/**
+ * @class SnapshotReader
+ * @brief Reads snapshot fields, reads past the end set the failed flag and return zeros
+ */
+class SnapshotReader {
+private:
+    // Next byte to read
+    const char* pos;
+
+    // End of the data
+    const char* end;
+
+    // Data was too short or malformed
+    bool failed = false;
+
+    /**
+     * @brief Takes next bytes
+     * @param size Number of bytes
+     * @return Pointer to them, nullptr if there are not enough
+     */
+    const char* take(size_t size);
+
+public:
+    /**
+     * @brief Creates reader of the data
+     * @param data Snapshot, has to outlive the reader
+     */
+    explicit SnapshotReader(std::string_view data) : pos(data.data()), end(data.data() + data.size()) {}
+
+    /**
+     * @brief Reads and checks header of the snapshot, prints the reason if it does not fit
+     * @param kind Expected kind
+     * @param definition Definition the state is restored into
+     * @return true if the snapshot can be restored into the definition
+     */
+    bool header(Snapshot::Kind kind, const MachineDefinition& definition);
+
+    uint8_t u8();
+    uint32_t u32();
+    int32_t i32() {
+        return static_cast<int32_t>(u32());
+    }
+    uint64_t u64();
+    double f64();
+
+    /**
+     * @brief Reads column written by SnapshotWriter::i32s()
+     * @param values Receives the values
+     * @param count Number of values
+     */
+    void i32s(int* values, size_t count);
+
+    /**
+     * @brief Reads string prefixed by its length
+     * @param value Receives the string, its buffer is reused
+     */
+    void text(std::string& value);
+
+    /**
+     * @brief Reads value written by SnapshotWriter::value()
+     * @param value Receives the value
+     */
+    void value(Value& value);
+
+    /**
+     * @brief Reads value written by SnapshotWriter::valuePayload()
+     * @param type Type of the value
+     * @param value Receives the value
+     */
+    void valuePayload(ValueType type, Value& value);
+
+    /**
+     * @brief Checks if everything read so far was present
+     */
+    bool ok() const {
+        return !failed;
+    }
+
+    /**
+     * @brief Checks if all data was read without errors
+     */
+    bool finished() const {
+        return !failed && pos == end;
+    }
+};
+
+#endif // SNAPSHOT_H
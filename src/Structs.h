@@ -10,6 +10,8 @@
 
 #include <string>
 #include <unordered_map>
+#include "ExprCompiler.h"
+#include "Value.h"
 
 /**
  * @struct Variable
@@ -18,7 +20,7 @@
 struct Variable {
     std::string type; // C type(int, bool, string etc.)
     std::string name; // Name of the variable
-    std::string value; // Value of the variable
+    Value value; // Value of the variable, stored natively according to type
 };
 
 /**
@@ -61,6 +63,60 @@ namespace std {
     };
 }
 
+/**
+ * @struct GuardCache
+ * @brief Results of a guard for input values seen before, kept by MachineInstance per transition
+ */
+struct GuardCache {
+    static constexpr size_t maxEntries = 64; // Results are dropped when there are more input values
+    std::unordered_map<std::string, bool> results; // input value: result of the guard
+    unsigned long variablesVersion = 0; // Version of the variables the results were computed with
+};
+
+/**
+ * @struct InputEvent
+ * @brief One event of a batch passed to MooreMachine::processInputs()
+ */
+struct InputEvent {
+    int inputId; // Id of the input from MooreMachine::findInput()
+    std::string value; // Value of the input
+};
+
+/**
+ * @struct OutputChange
+ * @brief Output whose value differs from the one after the previous event of the batch
+ */
+struct OutputChange {
+    int event; // Index of the event in the batch
+    int slot; // Output slot
+    std::string value; // New value of the output
+};
+
+/**
+ * @struct EventBatchResult
+ * @brief Outcome of MooreMachine::processInputs()
+ */
+struct EventBatchResult {
+    std::vector<int> states; // Current state after each event, index is the event index
+    std::vector<OutputChange> changes; // Changed outputs in event order
+};
+
+/**
+ * @struct CompiledTransition
+ * @brief Transition expression resolved against the machine at compile time
+ */
+struct CompiledTransition {
+    int id = -1; // Index among all transitions of the machine, assigned when MachineDefinition is built
+    int nextState = -1; // Index of the state the transition leads to
+    bool hasInput = false; // inputEvent is not empty
+    bool hasGuard = false; // boolExpr is not empty
+    bool hasDelay = false; // delay is not empty
+    CompiledExpr guard; // Compiled boolExpr
+    int delayMs = -1; // Delay given as number of milliseconds, -1 if it is not a number
+    int delaySlot = -1; // Slot of the variable holding the delay, -1 if it is not a variable
+    bool neverTaken = false; // Guard is statically false, the transition is left out of the state's table
+};
+
 /**
  * @struct State
  * @brief Represents a state in the Moore machine
@@ -73,6 +129,20 @@ struct State {
      * @brief Mapping from transition expressions to next state indices
      */
     std::unordered_map<TransitionExpression, int> transitions; // transition: {expression, next state}
+
+    CompiledExpr action; // Compiled outputExpr
+    bool constantAction = false; // Action only writes constants to outputs, entering the state copies outputRow
+    std::vector<std::string> outputRow; // Outputs after the constant action, indexed by output slot
+
+    /**
+     * @brief Compiled transitions grouped by input id
+     */
+    std::vector<CompiledTransition> compiled;
+
+    /**
+     * @brief Transitions of input id i are compiled[inputRuns[i]] .. compiled[inputRuns[i + 1] - 1]
+     */
+    std::vector<int> inputRuns;
 };
 
 #endif // STRUCTS_H
@@ -0,0 +1,31 @@
+/**
+ * @file SymbolTable.cpp
+ * @brief Implementation of the SymbolTable class
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#include "SymbolTable.h"
+
+using namespace std;
+
+int SymbolTable::intern(const string& name) {
+    auto it = slots.find(name);
+    if (it != slots.end()) {
+        return it->second;
+    }
+
+    int slot = static_cast<int>(names.size());
+    slots.emplace(name, slot);
+    names.push_back(name);
+    return slot;
+}
+
+int SymbolTable::find(const string& name) const {
+    auto it = slots.find(name);
+    return it == slots.end() ? -1 : it->second;
+}
+
+void SymbolTable::clear() {
+    slots.clear();
+    names.clear();
+}
@@ -0,0 +1,68 @@
+/**
+ * @file SymbolTable.h
+ * @brief Header file for the SymbolTable class
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#ifndef SYMBOLTABLE_H
+#define SYMBOLTABLE_H
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+/**
+ * @class SymbolTable
+ * @brief Interns names to dense integer slots
+ *
+ * Names are resolved only when expressions are compiled or at the API boundary,
+ * at runtime everything is addressed by the slot index.
+ */
+class SymbolTable {
+private:
+    // Name to slot mapping
+    std::unordered_map<std::string, int> slots;
+
+    // Slot to name mapping
+    std::vector<std::string> names;
+
+public:
+    /**
+     * @brief Gets slot of the name, adds it if it is not known yet
+     * @param name Name to intern
+     * @return Slot of the name
+     */
+    int intern(const std::string& name);
+
+    /**
+     * @brief Looks up slot of the name
+     * @param name Name to look up
+     * @return Slot of the name, -1 if the name is not known
+     */
+    int find(const std::string& name) const;
+
+    /**
+     * @brief Gets name of the slot
+     * @param slot Slot index
+     * @return Name interned to the slot
+     */
+    const std::string& name(int slot) const {
+        return names[slot];
+    }
+
+    /**
+     * @brief Gets number of interned names
+     * @return Number of slots
+     */
+    int size() const {
+        return static_cast<int>(names.size());
+    }
+
+    /**
+     * @brief Removes all names
+     */
+    void clear();
+};
+
+#endif // SYMBOLTABLE_H
@@ -0,0 +1,296 @@
+/**
+ * @file TimerWheel.cpp
+ * @brief Implementation of the TimerWheel class
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#include <algorithm>
+#include <limits>
+#include "TimerWheel.h"
+
+using namespace std;
+
+TimerWheel::TimerWheel(shared_ptr<Clock> clock)
+    : clock(move(clock)), wakeAt(numeric_limits<Clock::TimePoint::rep>::max()) {
+    origin = this->clock->now();
+    for (auto& level : slots) {
+        fill(begin(level), end(level), -1);
+    }
+}
+
+TimerWheel::~TimerWheel() {
+    stop();
+
+    // Timers that never fired are not due anymore
+    for (const Timer& timer : timers) {
+        if (timer.level != -1) {
+            clock->cancelNotify(timeOf(timer.expires));
+        }
+    }
+}
+
+uint64_t TimerWheel::tickOf(Clock::TimePoint time) const {
+    if (time <= origin) {
+        return 0;
+    }
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::milliseconds>(time - origin).count());
+}
+
+Clock::TimePoint TimerWheel::timeOf(uint64_t tick) const {
+    return origin + chrono::milliseconds(tick);
+}
+
+void TimerWheel::release(int index) {
+    Timer& timer = timers[index];
+    timer.callback = nullptr;
+    timer.level = -1;
+    timer.generation++;
+    timer.next = freeTimers;
+    freeTimers = index;
+    active--;
+}
+
+void TimerWheel::link(int index) {
+    Timer& timer = timers[index];
+    uint64_t delta = timer.expires - currentTick;
+
+    // Level is chosen by distance, the slot by the bits of the expiry belonging to the level
+    int level = 0;
+    while (level < levelCount - 1 && delta >= (uint64_t(1) << (levelBits * (level + 1)))) {
+        level++;
+    }
+
+    // Timer beyond the range of the wheel waits in the farthest slot and is placed again later
+    uint64_t placed = timer.expires;
+    uint64_t range = uint64_t(1) << (levelBits * levelCount);
+    if (delta >= range) {
+        placed = currentTick + range - 1;
+    }
+
+    timer.level = level;
+    timer.slot = static_cast<int>((placed >> (levelBits * level)) & (slotCount - 1));
+    timer.previous = -1;
+    timer.next = slots[level][timer.slot];
+    if (timer.next != -1) {
+        timers[timer.next].previous = index;
+    }
+    slots[level][timer.slot] = index;
+}
+
+void TimerWheel::unlink(int index) {
+    Timer& timer = timers[index];
+    if (timer.previous != -1) {
+        timers[timer.previous].next = timer.next;
+    }
+    else {
+        slots[timer.level][timer.slot] = timer.next;
+    }
+    if (timer.next != -1) {
+        timers[timer.next].previous = timer.previous;
+    }
+}
+
+void TimerWheel::cascade(int level, int slot) {
+    int index = slots[level][slot];
+    slots[level][slot] = -1;
+    while (index != -1) {
+        int next = timers[index].next;
+        link(index);
+        index = next;
+    }
+}
+
+void TimerWheel::advance(uint64_t target, vector<Callback>& due) {
+    while (currentTick < target) {
+        // Ticks without expiry or cascade are skipped at once
+        uint64_t next = nextTick();
+        if (next == noTick || next > target) {
+            currentTick = target;
+            return;
+        }
+        currentTick = next;
+
+        // Higher levels move down when the lower level wraps around
+        for (int level = 1; level < levelCount; level++) {
+            if ((currentTick & ((uint64_t(1) << (levelBits * level)) - 1)) != 0) {
+                break;
+            }
+            cascade(level, static_cast<int>((currentTick >> (levelBits * level)) & (slotCount - 1)));
+        }
+
+        // Every timer in the first level slot of the tick expires now
+        int slot = static_cast<int>(currentTick & (slotCount - 1));
+        int index = slots[0][slot];
+        slots[0][slot] = -1;
+        while (index != -1) {
+            int next = timers[index].next;
+            due.push_back(move(timers[index].callback));
+            release(index);
+            index = next;
+        }
+    }
+}
+
+uint64_t TimerWheel::nextTick() const {
+    if (active == 0) {
+        return noTick;
+    }
+
+    uint64_t best = noTick;
+    for (uint64_t offset = 1; offset <= slotCount; offset++) {
+        uint64_t tick = currentTick + offset;
+        if (slots[0][tick & (slotCount - 1)] != -1) {
+            best = tick;
+            break;
+        }
+    }
+
+    // Slot of a higher level has to be processed when it cascades
+    for (int level = 1; level < levelCount; level++) {
+        uint64_t base = currentTick >> (levelBits * level);
+        for (uint64_t offset = 1; offset <= slotCount; offset++) {
+            if (slots[level][(base + offset) & (slotCount - 1)] != -1) {
+                best = min(best, (base + offset) << (levelBits * level));
+                break;
+            }
+        }
+    }
+    return best;
+}
+
+void TimerWheel::updateWakeAt() {
+    uint64_t next = nextTick();
+    wakeAt.store(next == noTick ? numeric_limits<Clock::TimePoint::rep>::max() : timeOf(next).time_since_epoch().count(), memory_order_release);
+}
+
+TimerWheel::TimerId TimerWheel::schedule(chrono::milliseconds delay, Callback callback) {
+    lock_guard<mutex> lock(wheelMutex);
+    Clock::TimePoint dueTime = clock->now() + max(delay, chrono::milliseconds(0));
+
+    // Expiry is rounded up to whole tick, timer never fires early
+    uint64_t expires = tickOf(dueTime);
+    if (timeOf(expires) < dueTime) {
+        expires++;
+    }
+    expires = max(expires, currentTick + 1);
+
+    int index = freeTimers;
+    if (index == -1) {
+        index = static_cast<int>(timers.size());
+        timers.emplace_back();
+    }
+    else {
+        freeTimers = timers[index].next;
+    }
+
+    Timer& timer = timers[index];
+    timer.expires = expires;
+    timer.callback = move(callback);
+    link(index);
+    active++;
+
+    Clock::TimePoint::rep expiresAt = timeOf(expires).time_since_epoch().count();
+    if (expiresAt < wakeAt.load(memory_order_relaxed)) {
+        wakeAt.store(expiresAt, memory_order_release);
+    }
+    clock->notifyAt(timeOf(expires));
+
+    // Sleeping thread has to wake up sooner
+    if (expires < sleepingUntil) {
+        woken = true;
+        changed.notify_one();
+    }
+    return (static_cast<TimerId>(timer.generation) << 32) | static_cast<uint32_t>(index);
+}
+
+bool TimerWheel::cancel(TimerId id) {
+    lock_guard<mutex> lock(wheelMutex);
+    size_t index = static_cast<uint32_t>(id);
+    if (index >= timers.size()) {
+        return false;
+    }
+
+    Timer& timer = timers[index];
+    if (timer.level == -1 || timer.generation != static_cast<uint32_t>(id >> 32)) {
+        return false;
+    }
+    clock->cancelNotify(timeOf(timer.expires));
+    unlink(static_cast<int>(index));
+    release(static_cast<int>(index));
+    return true;
+}
+
+int TimerWheel::poll() {
+    vector<Callback> due;
+    {
+        lock_guard<mutex> lock(wheelMutex);
+        advance(tickOf(clock->now()), due);
+        updateWakeAt();
+    }
+
+    for (auto& callback : due) {
+        callback();
+    }
+    return static_cast<int>(due.size());
+}
+
+size_t TimerWheel::size() const {
+    lock_guard<mutex> lock(wheelMutex);
+    return active;
+}
+
+void TimerWheel::start() {
+    lock_guard<mutex> lock(wheelMutex);
+    if (worker.joinable()) {
+        return;
+    }
+    stopping = false;
+    worker = thread(&TimerWheel::run, this);
+}
+
+void TimerWheel::stop() {
+    {
+        lock_guard<mutex> lock(wheelMutex);
+        if (!worker.joinable()) {
+            return;
+        }
+        stopping = true;
+        woken = true;
+    }
+    changed.notify_all();
+    worker.join();
+}
+
+void TimerWheel::run() {
+    unique_lock<mutex> lock(wheelMutex);
+    while (!stopping) {
+        vector<Callback> due;
+        advance(tickOf(clock->now()), due);
+        updateWakeAt();
+
+        // Callbacks may schedule and cancel timers, so they run without the lock
+        if (!due.empty()) {
+            lock.unlock();
+            for (auto& callback : due) {
+                callback();
+            }
+            lock.lock();
+            continue;
+        }
+
+        woken = false;
+        uint64_t next = nextTick();
+        sleepingUntil = next;
+        if (next == noTick) {
+            changed.wait(lock, [this] {
+                return stopping || woken;
+            });
+        }
+        else {
+            clock->waitUntil(lock, changed, timeOf(next), [this] {
+                return stopping || woken;
+            });
+        }
+        sleepingUntil = 0;
+    }
+}
@@ -0,0 +1,222 @@
+/**
+ * @file TimerWheel.h
+ * @brief Header file for the TimerWheel class, timer service of the simulation
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Clock.h"
+
+/**
+ * @class TimerWheel
+ * @brief Hierarchical timer wheel with millisecond ticks
+ *
+ * Four levels of 64 slots cover about 4.6 hours, longer timers wait in the last
+ * level and are placed again when it cascades. Scheduling and cancelling are O(1),
+ * every tick fires one slot of the first level and now and then moves one slot of
+ * a higher level down. Timers are fired either by the thread started by start()
+ * or by whoever calls poll().
+ */
+class TimerWheel {
+public:
+    using TimerId = uint64_t;
+    using Callback = std::function<void()>;
+
+    // Id never returned by schedule()
+    static constexpr TimerId invalidTimer = 0;
+
+private:
+    static constexpr int levelBits = 6;
+    static constexpr int slotCount = 1 << levelBits;
+    static constexpr int levelCount = 4;
+
+    // No timer is waiting
+    static constexpr uint64_t noTick = UINT64_MAX;
+
+    /**
+     * @struct Timer
+     * @brief Scheduled callback, linked into the list of its slot
+     */
+    struct Timer {
+        uint64_t expires = 0; // Tick the timer fires at
+        Callback callback; // Called when the timer fires
+        int previous = -1; // Previous timer in the slot
+        int next = -1; // Next timer in the slot, also links free timers
+        int level = -1; // Level of the slot, -1 if the timer is not scheduled
+        int slot = 0; // Slot within the level
+        uint32_t generation = 1; // Incremented on reuse, outdates old ids
+    };
+
+    // Time source
+    std::shared_ptr<Clock> clock;
+
+    // Time of tick 0
+    Clock::TimePoint origin;
+
+    // Last tick processed
+    uint64_t currentTick = 0;
+
+    // Storage of all timers, index is part of the id
+    std::vector<Timer> timers;
+
+    // First free timer, -1 if none
+    int freeTimers = -1;
+
+    // First timer of every slot, -1 if the slot is empty
+    int slots[levelCount][slotCount];
+
+    // Number of scheduled timers
+    size_t active = 0;
+
+    // Protects everything above
+    mutable std::mutex wheelMutex;
+
+    // Tick of the next wake up as ticks of the clock, lower bound of the next expiry
+    std::atomic<Clock::TimePoint::rep> wakeAt;
+
+    // Thread firing the timers, if started
+    std::thread worker;
+
+    // Wakes the thread when an earlier timer is scheduled or when it should stop
+    std::condition_variable changed;
+
+    // Tick the thread sleeps until, noTick if it waits for any timer, 0 if it does not sleep
+    uint64_t sleepingUntil = 0;
+
+    // Thread should end
+    bool stopping = false;
+
+    // Thread was woken for a reason other than time
+    bool woken = false;
+
+    /**
+     * @brief Converts time to tick, rounds down
+     */
+    uint64_t tickOf(Clock::TimePoint time) const;
+
+    /**
+     * @brief Converts tick to time
+     */
+    Clock::TimePoint timeOf(uint64_t tick) const;
+
+    /**
+     * @brief Returns timer to the free list
+     * @param index Index of the timer
+     */
+    void release(int index);
+
+    /**
+     * @brief Puts scheduled timer into the slot matching its expiry
+     * @param index Index of the timer
+     */
+    void link(int index);
+
+    /**
+     * @brief Removes timer from its slot
+     * @param index Index of the timer
+     */
+    void unlink(int index);
+
+    /**
+     * @brief Moves timers of the slot of a higher level to lower levels
+     * @param level Level of the slot
+     * @param slot Slot to move
+     */
+    void cascade(int level, int slot);
+
+    /**
+     * @brief Processes ticks up to the target, collects callbacks of the expired timers
+     * @param target Last tick to process
+     * @param due Receives callbacks to call after the lock is released
+     */
+    void advance(uint64_t target, std::vector<Callback>& due);
+
+    /**
+     * @brief Finds tick the wheel has to be processed at next, either an expiry or a cascade
+     * @return Tick, noTick if no timer is scheduled
+     */
+    uint64_t nextTick() const;
+
+    /**
+     * @brief Publishes the next wake up for nextDue()
+     */
+    void updateWakeAt();
+
+    /**
+     * @brief Loop of the timer thread
+     */
+    void run();
+
+public:
+    /**
+     * @brief Creates timer wheel, no thread runs until start()
+     * @param clock Time source
+     */
+    explicit TimerWheel(std::shared_ptr<Clock> clock = Clock::real());
+
+    /**
+     * @brief Stops the thread, scheduled timers never fire
+     */
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    /**
+     * @brief Schedules callback, safe to call from any thread and from callbacks
+     * @param delay Time from now, the callback is not called sooner
+     * @param callback Called without any lock of the wheel held
+     * @return Id for cancel()
+     */
+    TimerId schedule(std::chrono::milliseconds delay, Callback callback);
+
+    /**
+     * @brief Cancels timer
+     * @param id Id from schedule()
+     * @return false if the timer already fired or was cancelled
+     */
+    bool cancel(TimerId id);
+
+    /**
+     * @brief Fires timers that expired, for callers driving the wheel from their own loop
+     * @return Number of fired timers
+     */
+    int poll();
+
+    /**
+     * @brief Gets earliest time poll() can fire anything, may be earlier than the real expiry
+     * @return Time, TimePoint::max() if no timer is scheduled
+     */
+    Clock::TimePoint nextDue() const {
+        return Clock::TimePoint(Clock::TimePoint::duration(wakeAt.load(std::memory_order_acquire)));
+    }
+
+    /**
+     * @brief Gets number of scheduled timers
+     */
+    size_t size() const;
+
+    /**
+     * @brief Starts thread firing the timers
+     */
+    void start();
+
+    /**
+     * @brief Stops and joins the thread, timers stay scheduled
+     */
+    void stop();
+};
+
+#endif // TIMERWHEEL_H
@@ -0,0 +1,144 @@
+/**
+ * @file Trace.cpp
+ * @brief Implementation of the trace recorder and reader
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include "Trace.h"
+
+using namespace std;
+
+TraceRecorder::~TraceRecorder() {
+    if (file.is_open()) {
+        flush();
+        file.close();
+    }
+}
+
+bool TraceRecorder::open(const string& filename, string_view snapshot, const vector<string>& initialOutputs, Clock::TimePoint now) {
+    file.open(filename, ios::binary | ios::trunc);
+    if (!file.is_open()) {
+        cout << "Failed to create trace " << filename << endl;
+        return false;
+    }
+
+    SnapshotWriter writer(buffer);
+    writer.u32(Trace::magic);
+    writer.u8(Trace::version & 0xff);
+    writer.u8(Trace::version >> 8);
+    writer.text(snapshot);
+    started = now;
+    outputs = initialOutputs;
+    flush();
+    return !failed;
+}
+
+void TraceRecorder::record(Trace::Kind kind, int inputId, string_view value, int state, const vector<string>& current, Clock::TimePoint now) {
+    SnapshotWriter writer(buffer);
+    writer.u8(static_cast<uint8_t>(kind));
+    writer.u64(static_cast<uint64_t>(max<long long>(0, chrono::duration_cast<chrono::microseconds>(now - started).count())));
+    if (kind == Trace::Kind::Input) {
+        writer.i32(inputId);
+        writer.text(value);
+    }
+    writer.i32(state);
+
+    // Count is not known until the outputs are compared, it is written in place afterwards
+    size_t countAt = buffer.size();
+    writer.u32(0);
+    if (outputs.size() != current.size()) {
+        outputs.resize(current.size());
+    }
+    uint32_t changed = 0;
+    for (size_t slot = 0; slot < current.size(); slot++) {
+        if (current[slot] != outputs[slot]) {
+            writer.u32(static_cast<uint32_t>(slot));
+            writer.text(current[slot]);
+            outputs[slot] = current[slot];
+            changed++;
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        buffer[countAt + i] = static_cast<char>(changed >> (8 * i));
+    }
+
+    records++;
+    if (buffer.size() >= bufferSize) {
+        flush();
+    }
+}
+
+void TraceRecorder::flush() {
+    if (buffer.empty()) {
+        return;
+    }
+    if (!failed && !file.write(buffer.data(), buffer.size())) {
+        cout << "Failed to write trace" << endl;
+        failed = true;
+    }
+    buffer.clear();
+}
+
+bool TraceReader::open(const string& filename) {
+    ifstream file(filename, ios::binary);
+    if (!file.is_open()) {
+        cout << "Failed to open trace " << filename << endl;
+        return false;
+    }
+    data.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+
+    reader.emplace(data);
+    uint32_t magic = reader->u32();
+    uint16_t version = reader->u8();
+    version |= static_cast<uint16_t>(reader->u8()) << 8;
+    reader->text(snapshot);
+    if (!reader->ok() || magic != Trace::magic) {
+        cout << filename << " is not a trace" << endl;
+        reader.reset();
+        return false;
+    }
+    if (version != Trace::version) {
+        cout << "Trace version " << version << " is not supported" << endl;
+        reader.reset();
+        return false;
+    }
+    records = 0;
+    return true;
+}
+
+bool TraceReader::next(TraceRecord& record) {
+    if (!reader || !reader->ok() || reader->finished()) {
+        return false;
+    }
+
+    uint8_t kind = reader->u8();
+    record.kind = static_cast<Trace::Kind>(kind);
+    record.time = reader->u64();
+    record.inputId = -1;
+    record.value.clear();
+    if (record.kind == Trace::Kind::Input) {
+        record.inputId = reader->i32();
+        reader->text(record.value);
+    }
+    record.state = reader->i32();
+
+    // Every change takes at least 8 bytes, larger counts can only come from a damaged trace
+    uint32_t count = reader->u32();
+    record.changes.resize(min<size_t>(count, data.size() / 8 + 1));
+    for (OutputChange& change : record.changes) {
+        change.event = static_cast<int>(records);
+        change.slot = static_cast<int>(reader->u32());
+        reader->text(change.value);
+    }
+
+    if (!reader->ok() || (record.kind != Trace::Kind::Input && record.kind != Trace::Kind::Timer) || record.changes.size() != count) {
+        cout << "Trace is damaged at record " << records << endl;
+        reader.reset();
+        return false;
+    }
+    records++;
+    return true;
+}
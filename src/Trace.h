@@ -0,0 +1,197 @@
+/**
+ * @file Trace.h
+ * @brief Binary trace of processed events, written by TraceRecorder and read back by TraceReader
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Clock.h"
+#include "Snapshot.h"
+#include "Structs.h"
+
+/**
+ * @struct Trace
+ * @brief Constants of the trace format
+ *
+ * Trace starts with magic, format version and snapshot of the machine taken when
+ * recording started, see MooreMachine::saveSnapshot(). Records follow, one per
+ * processed event: kind, time since the start in microseconds, input id and value
+ * for inputs, state after the event and outputs that changed. Fields are encoded
+ * by SnapshotWriter.
+ */
+struct Trace {
+    // First four bytes of every trace
+    static constexpr uint32_t magic = 0x52544D4D; // "MMTR"
+
+    // Incremented whenever a record changes, older traces are refused
+    static constexpr uint16_t version = 1;
+
+    /**
+     * @enum Kind
+     * @brief What caused the event
+     */
+    enum class Kind : uint8_t {
+        Input = 1, // Input passed to the machine
+        Timer = 2 // Delayed transition that fired
+    };
+};
+
+/**
+ * @struct TraceRecord
+ * @brief One event of a trace
+ */
+struct TraceRecord {
+    Trace::Kind kind = Trace::Kind::Input; // What caused the event
+    uint64_t time = 0; // Microseconds since the start of the recording
+    int inputId = -1; // Id of the input, -1 for timers
+    std::string value; // Value of the input
+    int state = -1; // State after the event
+    std::vector<OutputChange> changes; // Outputs that changed, event is the index of the record
+};
+
+/**
+ * @class TraceRecorder
+ * @brief Appends records to a trace file through a buffer, the file is written in large blocks
+ */
+class TraceRecorder {
+private:
+    // Bytes are written once the buffer grows past this
+    static constexpr size_t bufferSize = 1 << 16;
+
+    // Trace file
+    std::ofstream file;
+
+    // Records not written yet
+    std::string buffer;
+
+    // Time the recording started
+    Clock::TimePoint started;
+
+    // Outputs after the previous record, changes are recorded against them
+    std::vector<std::string> outputs;
+
+    // Index of the next record
+    size_t records = 0;
+
+    // Writing failed, the reason was printed
+    bool failed = false;
+
+public:
+    TraceRecorder() = default;
+
+    /**
+     * @brief Flushes and closes the file
+     */
+    ~TraceRecorder();
+
+    TraceRecorder(const TraceRecorder&) = delete;
+    TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+    /**
+     * @brief Creates trace file and writes its header, prints the reason if it can not be created
+     * @param filename File to write
+     * @param snapshot Snapshot of the machine the records start from
+     * @param initialOutputs Outputs of the machine at that point
+     * @param now Time of the start
+     * @return true if the file was created
+     */
+    bool open(const std::string& filename, std::string_view snapshot, const std::vector<std::string>& initialOutputs, Clock::TimePoint now);
+
+    /**
+     * @brief Appends record of an event
+     * @param kind What caused the event
+     * @param inputId Id of the input, ignored for timers
+     * @param value Value of the input, ignored for timers
+     * @param state State after the event
+     * @param current Outputs after the event
+     * @param now Time of the event
+     */
+    void record(Trace::Kind kind, int inputId, std::string_view value, int state, const std::vector<std::string>& current, Clock::TimePoint now);
+
+    /**
+     * @brief Writes buffered records to the file
+     */
+    void flush();
+
+    /**
+     * @brief Gets number of records written so far
+     */
+    size_t size() const {
+        return records;
+    }
+};
+
+/**
+ * @class TraceReader
+ * @brief Reads trace file, the whole file is loaded at once and records are decoded in place
+ */
+class TraceReader {
+private:
+    // Contents of the file
+    std::string data;
+
+    // Reader of the records, created once the file is loaded
+    std::optional<SnapshotReader> reader;
+
+    // Snapshot from the header
+    std::string snapshot;
+
+    // Index of the next record
+    size_t records = 0;
+
+public:
+    TraceReader() = default;
+
+    TraceReader(const TraceReader&) = delete;
+    TraceReader& operator=(const TraceReader&) = delete;
+
+    /**
+     * @brief Loads trace file and reads its header, prints the reason if it can not be used
+     * @param filename File to read
+     * @return true if the trace can be read
+     */
+    bool open(const std::string& filename);
+
+    /**
+     * @brief Gets snapshot of the machine the records start from
+     */
+    const std::string& getSnapshot() const {
+        return snapshot;
+    }
+
+    /**
+     * @brief Reads next record, prints the reason if the trace is damaged
+     * @param record Receives the record, its buffers are reused
+     * @return false at the end of the trace or if it is damaged
+     */
+    bool next(TraceRecord& record);
+
+    /**
+     * @brief Checks if all records were read without errors
+     */
+    bool finished() const {
+        return reader && reader->finished();
+    }
+};
+
+/**
+ * @struct TraceReplayResult
+ * @brief Outcome of MooreMachine::replayTrace()
+ */
+struct TraceReplayResult {
+    size_t events = 0; // Records replayed
+    size_t mismatches = 0; // Records whose state or outputs differ from the recorded ones
+    long long firstMismatch = -1; // Index of the first such record, -1 if there is none
+};
+
+#endif // TRACE_H
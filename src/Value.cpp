@@ -0,0 +1,150 @@
+/**
+ * @file Value.cpp
+ * @brief Implementation of the Value class
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "Value.h"
+
+using namespace std;
+
+ValueType Value::typeOf(const string& declaredType) {
+    if (declaredType == "int") {
+        return ValueType::Int;
+    }
+    if (declaredType == "double" || declaredType == "float") {
+        return ValueType::Double;
+    }
+    if (declaredType == "bool") {
+        return ValueType::Bool;
+    }
+    if (declaredType == "char") {
+        return ValueType::Char;
+    }
+    return ValueType::String;
+}
+
+int Value::parseInt(string_view text) {
+    // Skip leading whitespace and plus sign like strtol does, from_chars accepts neither
+    size_t pos = 0;
+    while (pos < text.size() && isspace(static_cast<unsigned char>(text[pos]))) {
+        pos++;
+    }
+    if (pos < text.size() && text[pos] == '+') {
+        pos++;
+    }
+
+    long result = 0;
+    from_chars(text.data() + pos, text.data() + text.size(), result);
+    return static_cast<int>(result);
+}
+
+double Value::parseDouble(string_view text) {
+    // strtod needs null terminated text, numbers are short so copy to the stack
+    char buffer[64];
+    size_t length = min(text.size(), sizeof(buffer) - 1);
+    memcpy(buffer, text.data(), length);
+    buffer[length] = '\0';
+    return strtod(buffer, nullptr);
+}
+
+Value Value::parse(const string& declaredType, const string& text) {
+    return Value(text).convert(typeOf(declaredType));
+}
+
+Value Value::convert(ValueType target) const {
+    if (target == type) {
+        return *this;
+    }
+
+    string_view text = asString();
+
+    switch (target) {
+        case ValueType::Int:
+            return asInt();
+        case ValueType::Double:
+            return asDouble();
+        case ValueType::Bool:
+            if (type == ValueType::String) {
+                return text == "true" || text == "1";
+            }
+            return asBool();
+        case ValueType::Char:
+            if (type == ValueType::String) {
+                return text.empty() ? '\0' : text[0];
+            }
+            return static_cast<char>(asInt());
+        case ValueType::String:
+            return toString();
+    }
+    return *this;
+}
+
+int Value::asInt() const {
+    switch (type) {
+        case ValueType::Int:
+            return intValue;
+        case ValueType::Double:
+            return static_cast<int>(doubleValue);
+        case ValueType::Bool:
+            return boolValue ? 1 : 0;
+        case ValueType::Char:
+            return charValue;
+        case ValueType::String:
+            return parseInt(asString());
+    }
+    return 0;
+}
+
+double Value::asDouble() const {
+    switch (type) {
+        case ValueType::Double:
+            return doubleValue;
+        case ValueType::String:
+            return parseDouble(asString());
+        default:
+            return asInt();
+    }
+}
+
+bool Value::asBool() const {
+    switch (type) {
+        case ValueType::Int:
+            return intValue != 0;
+        case ValueType::Double:
+            return doubleValue != 0.0;
+        case ValueType::Bool:
+            return boolValue;
+        case ValueType::Char:
+            return charValue != '\0';
+        case ValueType::String:
+            return !asString().empty();
+    }
+    return false;
+}
+
+string Value::toString() const {
+    switch (type) {
+        case ValueType::Int:
+            return to_string(intValue);
+        case ValueType::Double: {
+            // Same format as ostream with default precision, without allocating the stream
+            char buffer[32];
+            snprintf(buffer, sizeof(buffer), "%g", doubleValue);
+            return buffer;
+        }
+        case ValueType::Bool:
+            return boolValue ? "true" : "false";
+        case ValueType::Char:
+            return string(1, charValue);
+        case ValueType::String:
+            return string(asString());
+    }
+    return "";
+}
@@ -0,0 +1,157 @@
+/**
+ * @file Value.h
+ * @brief Header file for the Value class, typed runtime value of variables and expressions
+ * @author Tomáš Šedo (xsedot00)
+*/
+
+#ifndef VALUE_H
+#define VALUE_H
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * @enum ValueType
+ * @brief Runtime types, declared variable types map onto them
+ */
+enum class ValueType : uint8_t { Int, Double, Bool, Char, String };
+
+/**
+ * @class Value
+ * @brief Tagged value, numbers are stored natively and strings use std::string (short strings stay inline)
+ *
+ * String value can also borrow text owned by someone else (program strings, input value,
+ * variables), the VM uses borrowed values so that evaluation does not copy strings.
+ * Borrowed value must not outlive the text, call own() before storing it.
+ */
+class Value {
+private:
+    // Which member holds the value
+    ValueType type = ValueType::Int;
+
+    union {
+        int intValue;
+        double doubleValue;
+        bool boolValue;
+        char charValue;
+    };
+
+    // Used only when type is String
+    std::string stringValue;
+
+    // Text the value refers to when borrowed is set, stringValue is unused then
+    std::string_view borrowedValue;
+    bool borrowed = false;
+
+public:
+    Value() : intValue(0) {}
+    Value(int value) : type(ValueType::Int), intValue(value) {}
+    Value(double value) : type(ValueType::Double), doubleValue(value) {}
+    Value(bool value) : type(ValueType::Bool), boolValue(value) {}
+    Value(char value) : type(ValueType::Char), charValue(value) {}
+    Value(std::string value) : type(ValueType::String), intValue(0), stringValue(std::move(value)) {}
+    Value(const char* value) : Value(std::string(value)) {}
+
+    /**
+     * @brief Creates string value borrowing the text, nothing is copied
+     * @param text Text that outlives the value
+     * @return Borrowed string value
+     */
+    static Value view(std::string_view text) {
+        Value value;
+        value.type = ValueType::String;
+        value.borrowedValue = text;
+        value.borrowed = true;
+        return value;
+    }
+
+    /**
+     * @brief Creates value referring to this one, strings are borrowed instead of copied
+     * @return Borrowed string value or copy of other types
+     */
+    Value ref() const {
+        return type == ValueType::String ? view(asString()) : *this;
+    }
+
+    /**
+     * @brief Copies borrowed text into the value, so it can be stored
+     */
+    void own() {
+        if (borrowed) {
+            stringValue.assign(borrowedValue);
+            borrowed = false;
+        }
+    }
+
+    /**
+     * @brief Parses integer like strtol in base 10 (0 if not a number), text does not need to be null terminated
+     */
+    static int parseInt(std::string_view text);
+
+    /**
+     * @brief Parses floating point number like strtod (0 if not a number)
+     */
+    static double parseDouble(std::string_view text);
+
+    /**
+     * @brief Parses value of the declared variable type, used when loading
+     * @param declaredType Declared C type ("int", "double", "float", "bool", "char", "string")
+     * @param text Value in its textual form
+     * @return Parsed value, zero value of the type if text is not valid
+     */
+    static Value parse(const std::string& declaredType, const std::string& text);
+
+    /**
+     * @brief Maps declared C type to runtime type
+     * @param declaredType Declared C type
+     * @return Runtime type, String for unknown types
+     */
+    static ValueType typeOf(const std::string& declaredType);
+
+    /**
+     * @brief Converts value to another runtime type
+     * @param target Target type
+     * @return Converted value
+     */
+    Value convert(ValueType target) const;
+
+    ValueType getType() const {
+        return type;
+    }
+
+    bool isNumeric() const {
+        return type == ValueType::Int || type == ValueType::Double || type == ValueType::Char;
+    }
+
+    /**
+     * @brief Gets integer form, strings are parsed like atoi (0 if not a number)
+     */
+    int asInt() const;
+
+    /**
+     * @brief Gets floating point form, strings are parsed (0 if not a number)
+     */
+    double asDouble() const;
+
+    /**
+     * @brief Gets truthiness, non zero number or non empty string
+     */
+    bool asBool() const;
+
+    /**
+     * @brief Gets string content, empty for non string values
+     */
+    std::string_view asString() const {
+        return borrowed ? borrowedValue : std::string_view(stringValue);
+    }
+
+    /**
+     * @brief Converts value to its textual form, used when saving and for outputs
+     * @return Text of the value (bools as "true"/"false")
+     */
+    std::string toString() const;
+};
+
+#endif // VALUE_H
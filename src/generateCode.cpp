@@ -17,39 +17,90 @@ string CodeGenerator::escapeQuotes(const string &str)
     return escaped;
 }
 
-bool CodeGenerator::generateCode(const nlohmann::ordered_json json, const string &fileName)
+/**
+ * @class MachineCollector
+ * @brief Keeps the parts of the machine the generator needs, in the order they are visited
+ */
+class MachineCollector : public MachineVisitor
 {
-    ofstream code(fileName);
-    if (!code.is_open())
-    {
-        return false;
-    }
+    public:
+        /**
+         * @struct Transition
+         * @brief Transition of a state as the generator reads it
+         */
+        struct Transition
+        {
+            string inputEvent;
+            string boolExpr;
+            string delay;
+            string nextState;
+        };
+
+        string machineName;
+        string machineDescription;
+        vector<string> stateNames;
+        map<string, string> stateOutputs;
+        vector<string> inputs;
+        vector<string> variables;
+        vector<pair<string, vector<Transition>>> transitionBlocks;
+
+        void machine(const string &name, const string &description, const vector<string> &inputs, const vector<string> &) override
+        {
+            machineName = name;
+            machineDescription = description;
+            this->inputs = inputs;
+        }
 
-    string machineName = json["name"];
-    string machineDescription = json["description"];
+        void variable(const Variable &var) override
+        {
+            variables.push_back(var.type);
+            variables.push_back(var.name);
+            variables.push_back(var.value.toString());
+        }
 
-    vector<string> stateNames;
-    for (const auto& state : json["states"]) {
-        stateNames.push_back(state["name"]);
-    }
+        void state(const State &state) override
+        {
+            stateNames.push_back(state.name);
+            stateOutputs[state.name] = state.outputExpr;
+        }
 
-    map<string, string> stateOutputs;
-    for (const auto& state : json["states"]) {
-        stateOutputs[state["name"]] = state["outputExpr"];
-    }
+        void transitions(const State &state) override
+        {
+            transitionBlocks.push_back({state.name, {}});
+        }
+
+        void transition(const TransitionExpression &expr, const string &nextState) override
+        {
+            transitionBlocks.back().second.push_back({expr.inputEvent, expr.boolExpr, expr.delay, nextState});
+        }
 
-    vector<string> inputs;
-    for (const auto &input : json["inputs"]) {
-        inputs.push_back(input);
+        void end() override
+        {
+        }
+};
+
+bool CodeGenerator::generateCode(MooreMachine &machine, const string &fileName)
+{
+    MachineCollector collected;
+    machine.serialize(collected);
+    if (collected.stateNames.empty())
+    {
+        return false;
     }
 
-    vector<string> variables;
-    for (const auto &var : json["variables"]) {
-        variables.push_back(var["type"]);
-        variables.push_back(var["name"]);
-        variables.push_back(var["value"]);
+    ofstream code(fileName);
+    if (!code.is_open())
+    {
+        return false;
     }
 
+    const string &machineName = collected.machineName;
+    const string &machineDescription = collected.machineDescription;
+    const vector<string> &stateNames = collected.stateNames;
+    map<string, string> &stateOutputs = collected.stateOutputs;
+    const vector<string> &inputs = collected.inputs;
+    const vector<string> &variables = collected.variables;
+
     code << "#include <iostream>\n";
     code << "#include <string>\n";
     code << "#include <vector>\n";
@@ -112,12 +163,11 @@ bool CodeGenerator::generateCode(const nlohmann::ordered_json json, const string
     code << "void processTimeoutState() {\n";
     code << "    switch(currentState) {\n";
 
-    for (const auto &transitionBlock : json["transitions"]) {
-        string state = transitionBlock["name"];
-        for (const auto &transition : transitionBlock["transitions"]) {
-            string inputEvent = transition["expression"]["inputEvent"];
-            string delayName = transition["expression"]["delay"];
-            string nextState = transition["nextState"];
+    for (const auto &[state, transitions] : collected.transitionBlocks) {
+        for (const auto &transition : transitions) {
+            const string &inputEvent = transition.inputEvent;
+            const string &delayName = transition.delay;
+            const string &nextState = transition.nextState;
 
             if (inputEvent.empty() && !delayName.empty()) {
                 code << "        case " << state << ": {\n";
@@ -159,18 +209,16 @@ bool CodeGenerator::generateCode(const nlohmann::ordered_json json, const string
     code << "void processInput(const string &input, const string &value) {\n";
     code << "    switch(currentState) {\n";
 
-    for (const auto &transitionBlock : json["transitions"])
+    for (const auto &[state, transitions] : collected.transitionBlocks)
     {
-        string state = transitionBlock["name"];
         code << "        case " << state << ":\n";
         code << "        {\n";
 
-        for (const auto &transition : transitionBlock["transitions"])
+        for (const auto &transition : transitions)
         {
-            string inputEvent = transition["expression"]["inputEvent"];
-            string boolExpr = transition["expression"]["boolExpr"];
-            string delay = transition["expression"]["delay"];
-            string nextState = transition["nextState"];
+            const string &inputEvent = transition.inputEvent;
+            const string &boolExpr = transition.boolExpr;
+            const string &nextState = transition.nextState;
 
             if (!inputEvent.empty())
             {
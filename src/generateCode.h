@@ -9,25 +9,26 @@
 
 using namespace std;
 
-#include "json.hpp"
+#include "MooreMachine.h"
+#include <map>
 #include <string>
 #include <iostream>
 #include <fstream>
 
 /**
  * @class CodeGenerator
- * @brief Generates C++ code from Moore machine JSON definitions
+ * @brief Generates C++ code from Moore machine definitions
  */
 class CodeGenerator
 {
     public:
         /**
-         * @brief Generates C++ code from Moore machine JSON
-         * @param json Moore machine definition in JSON format
+         * @brief Generates C++ code from Moore machine
+         * @param machine Moore machine, read through MooreMachine::serialize() without building JSON
          * @param fileName Output file path for generated code
          * @return true if generation succeeded, false otherwise
          */
-        static bool generateCode(const nlohmann::ordered_json json, const string &fileName);
+        static bool generateCode(MooreMachine &machine, const string &fileName);
 
         /**
          * @brief process escape quotes while processing output
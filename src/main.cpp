@@ -5,10 +5,36 @@
  */
 
 #include <QApplication>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "MachineImage.h"
+#include "MooreMachine.h"
 #include "startWindow.h"
 
 int main(int argc, char **argv)
 {
+    // proj --compile machine.json machine.mmi converts the machine without starting the GUI
+    if (argc == 4 && std::string(argv[1]) == "--compile") {
+        return MachineImage::convert(argv[2], argv[3]) ? 0 : 1;
+    }
+
+    // proj --replay machine.json trace.mmt feeds recorded events through the machine and reports how fast
+    if (argc == 4 && std::string(argv[1]) == "--replay") {
+        MooreMachine machine;
+        machine.loadFromJSONFile(argv[2]);
+        TraceReplayResult result;
+        auto started = std::chrono::steady_clock::now();
+        bool replayed = machine.replayTrace(argv[3], result);
+        std::chrono::duration<double> took = std::chrono::steady_clock::now() - started;
+        std::cout << result.events << " events in " << took.count() << " s, " << result.mismatches << " mismatches";
+        if (result.firstMismatch != -1) {
+            std::cout << ", first at event " << result.firstMismatch;
+        }
+        std::cout << std::endl;
+        return replayed && result.mismatches == 0 ? 0 : 1;
+    }
+
     QApplication a(argc, argv);
     StartupWindow w;
     w.show();
@@ -59,6 +59,11 @@ MainWindow::MainWindow(const QString &name, const QString &description, QWidget
 
     // Input handling
     connect(ui->inValue, &QLineEdit::returnPressed, this, &MainWindow::handleInput);
+
+    // Delays are fired on the GUI thread, so the machine is never changed from two threads
+    delayTimer.setSingleShot(true);
+    connect(&delayTimer, &QTimer::timeout, this, &MainWindow::handleDelayTimer);
+    followDelays();
 }
 
 // Build states from loaded file
@@ -94,12 +99,7 @@ void MainWindow::handleInput() {
 
     int index = machine.getCurrentState();
     updateState(index);
-
-    // Update state highlight when delay is triggered
-    machine.autoTransition = [this](int index)
-    {
-        QMetaObject::invokeMethod(this, "handleStateUpdate", Qt::QueuedConnection, Q_ARG(int, index));
-    };
+    scheduleDelayTimer();
 
     ui->inValue->clear();
     ui->inLast->appendPlainText(input + " = " + value);
@@ -182,6 +182,7 @@ void MainWindow::startSimulation()
 
     simulationStart = true;
     machine.processStartState();
+    scheduleDelayTimer();
     highlightState(currentState);
     ui->outValue->appendPlainText(QString::fromStdString(machine.getCurrentOutput()));
 }
@@ -206,6 +207,7 @@ void MainWindow::resetSimulation()
     simulationStart = false;
     machine.setInitialOutput();
     machine.processStartState();
+    scheduleDelayTimer();
 
     const auto &states = machine.getStates();
     int startIndex = machine.getStartState();
@@ -241,6 +243,8 @@ void MainWindow::deleteScene()
     stateItems.clear();
     transitionItems.clear();
     machine.clear();
+    delayTimer.stop();
+    followDelays();
     stateIndexMap.clear();
     lastInput.clear();
     logText("Scene cleared");
@@ -442,6 +446,7 @@ void MainWindow::clearHighlight(StateItem* state) {
 void MainWindow::loadAutomatonFromMooreMachine(const QString &filename)
 {
     JsonAutomaton automaton = FileParser::loadAutomatonFromMooreMachine(filename, machine);
+    followDelays();
 
     ui->nameDesc->setText(automaton.name + " - " + automaton.description);
     logText("Loaded automaton: " + automaton.name);
@@ -454,7 +459,7 @@ void MainWindow::loadAutomatonFromMooreMachine(const QString &filename)
     // Get all defined variables
     for (const auto& var : machine.getVars())
     {
-        QString variable = QString::fromStdString(var.type + " " + var.name + " = " + var.value);
+        QString variable = QString::fromStdString(var.type + " " + var.name + " = " + var.value.toString());
          ui->varValue->appendPlainText(variable);
     }
 
@@ -503,10 +508,8 @@ void MainWindow::generateCode()
         return;
     }
 
-    auto json = machine.getJson();
-
     CodeGenerator generator;
-    if (generator.generateCode(json, fileName.toStdString()))
+    if (generator.generateCode(machine, fileName.toStdString()))
     {
         logText("C++ code generated");
     }
@@ -552,6 +555,37 @@ void MainWindow::handleStateUpdate(int index)
     }
 }
 
+void MainWindow::followDelays()
+{
+    machine.setTimerThread(false);
+
+    // Update state highlight when delay is triggered
+    machine.autoTransition = [this](int index)
+    {
+        handleStateUpdate(index);
+    };
+}
+
+void MainWindow::handleDelayTimer()
+{
+    machine.pollTimers();
+    scheduleDelayTimer();
+}
+
+void MainWindow::scheduleDelayTimer()
+{
+    Clock::TimePoint due = machine.nextTimerDue();
+    if (due == Clock::TimePoint::max())
+    {
+        delayTimer.stop();
+        return;
+    }
+
+    // Round up, a timer firing early would find nothing due
+    auto left = chrono::ceil<chrono::milliseconds>(due - machine.getClock()->now());
+    delayTimer.start(static_cast<int>(max<long long>(0, left.count())));
+}
+
 // destructor
 MainWindow::~MainWindow()
 {
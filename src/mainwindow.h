@@ -19,6 +19,7 @@
 #include <QMimeData>
 #include <QTextStream>
 #include <QProcess>
+#include <QTimer>
 #include "startWindow.h"
 #include "startWindow.h"
 #include "stateitem.h"
@@ -244,7 +245,22 @@ private slots:
      */
     void handleStateUpdate(int index);
 
+    /**
+     * @brief Fires delays of the machine that passed and waits for the next one
+     */
+    void handleDelayTimer();
+
 private:
+    /**
+     * @brief Makes the GUI follow delayed transitions of the machine, needed again whenever the machine is cleared or loaded
+     */
+    void followDelays();
+
+    /**
+     * @brief Starts delayTimer for the next delay of the machine, stops it if there is none
+     */
+    void scheduleDelayTimer();
+
     Ui::MainWindow *ui;                         // UI components
     QGraphicsScene *scene;                      // Scene for state diagram
     QMap<QString, Transition> transitionItems;  // Map of transitions
@@ -255,6 +271,7 @@ private:
     MooreMachine machine;                       // Moore machine model
     bool simulationStart = false;               // Flag for simulation state
     QMap<QString, int> stateIndexMap;           // Maps state names to indixes
+    QTimer delayTimer;                          // Fires delays of the machine on the GUI thread
 };
 
 #endif // MAINWINDOW_H
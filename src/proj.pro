@@ -14,7 +14,26 @@ SOURCES += \
     mainwindow.cpp \
     startWindow.cpp \
     stateitem.cpp \
+    Clock.cpp \
+    EventLoop.cpp \
     CodeExecutor.cpp \
+    ExprCompiler.cpp \
+    ExprParser.cpp \
+    ExprOptimizer.cpp \
+    GuardBatch.cpp \
+    InstancePool.cpp \
+    InstanceView.cpp \
+    MachineImage.cpp \
+    MachineJsonReader.cpp \
+    MachineJsonWriter.cpp \
+    MachineInstance.cpp \
+    Snapshot.cpp \
+    Trace.cpp \
+    OutputHistory.cpp \
+    SessionScheduler.cpp \
+    SymbolTable.cpp \
+    TimerWheel.cpp \
+    Value.cpp \
     MooreMachine.cpp \
     fileParser.cpp \
     stateManager.cpp \
@@ -27,7 +46,31 @@ HEADERS += \
     mainwindow.h \
     startWindow.h \
     stateitem.h \
+    Clock.h \
+    EventLoop.h \
     CodeExecutor.h \
+    Bytecode.h \
+    ExprCompiler.h \
+    ExprAst.h \
+    ExprParser.h \
+    ExprOptimizer.h \
+    GuardBatch.h \
+    InstancePool.h \
+    InstanceView.h \
+    MachineDefinition.h \
+    LockFreeQueue.h \
+    MachineImage.h \
+    MachineJsonReader.h \
+    MachineJsonWriter.h \
+    MachineVisitor.h \
+    MachineInstance.h \
+    Snapshot.h \
+    Trace.h \
+    OutputHistory.h \
+    SessionScheduler.h \
+    SymbolTable.h \
+    TimerWheel.h \
+    Value.h \
     MooreMachine.h \
     Structs.h \
     fileParser.h \